@@ -6,11 +6,23 @@ HELLO_LIB="src/libhello.so"
 
 # Kompilacja bibliotek i programów testowych z obsługą błędów
 gcc -shared -fPIC src/memory_monitor.c -o src/libmemory_monitor.so -ldl -pthread -g || { echo "Kompilacja libmemory_monitor.so nie powiodła się"; exit 1; }
+gcc src/memory_ring_reader.c -o src/memory_ring_reader || { echo "Kompilacja memory_ring_reader nie powiodła się"; exit 1; }
 gcc -shared -fPIC src/libhello.c -o src/libhello.so -ldl -pthread -g || { echo "Kompilacja libhello.so nie powiodła się"; exit 1; }
 gcc tests/test_allocations.c -o tests/test_allocations || { echo "Kompilacja test_allocations nie powiodła się"; exit 1; }
 gcc tests/test_mmap.c -o tests/test_mmap || { echo "Kompilacja test_mmap nie powiodła się"; exit 1; }
 gcc tests/test_shm.c -o tests/test_shm || { echo "Kompilacja test_shm nie powiodła się"; exit 1; }
+gcc tests/test_realloc_growth.c -o tests/test_realloc_growth || { echo "Kompilacja test_realloc_growth nie powiodła się"; exit 1; }
+gcc tests/test_threads.c -o tests/test_threads -pthread || { echo "Kompilacja test_threads nie powiodła się"; exit 1; }
+gcc tests/test_invalid_free.c -o tests/test_invalid_free || { echo "Kompilacja test_invalid_free nie powiodła się"; exit 1; }
+gcc tests/test_guarded.c -o tests/test_guarded || { echo "Kompilacja test_guarded nie powiodła się"; exit 1; }
+gcc tests/test_numa.c -o tests/test_numa || { echo "Kompilacja test_numa nie powiodła się"; exit 1; }
+gcc tests/test_peak.c -o tests/test_peak || { echo "Kompilacja test_peak nie powiodła się"; exit 1; }
+gcc tests/test_filter.c -o tests/test_filter -pthread || { echo "Kompilacja test_filter nie powiodła się"; exit 1; }
+gcc tests/test_aligned.c -o tests/test_aligned || { echo "Kompilacja test_aligned nie powiodła się"; exit 1; }
+g++ tests/test_cxx.cpp -o tests/test_cxx || { echo "Kompilacja test_cxx nie powiodła się"; exit 1; }
 gcc tests/test_library_load.c -o tests/test_library_load -ldl || { echo "Kompilacja test_library_load nie powiodła się"; exit 1; }
+gcc tests/test_metrics.c -o tests/test_metrics || { echo "Kompilacja test_metrics nie powiodła się"; exit 1; }
+gcc tests/test_ring_fork.c -o tests/test_ring_fork || { echo "Kompilacja test_ring_fork nie powiodła się"; exit 1; }
 
 # Sprawdzenie istnienia bibliotek monitorujących
 if [ ! -f "$MONITOR_LIB" ] || [ ! -f "$HELLO_LIB" ]; then
@@ -22,10 +34,10 @@ fi
 export LD_LIBRARY_PATH="$LD_LIBRARY_PATH:src"
 
 # Usunięcie poprzednich wyników
-rm -f monitor_*.out strace_*.txt
+rm -f monitor_*.out strace_*.txt monitor_*.ring monitor_*.csv
 
 # Lista testów do uruchomienia
-TESTS=("test_allocations" "test_mmap" "test_shm" "test_library_load", "script_test.sh")
+TESTS=("test_allocations" "test_mmap" "test_shm" "test_realloc_growth" "test_threads" "test_library_load", "script_test.sh")
 for TEST in "${TESTS[@]}"; do
   echo "Uruchamianie $TEST z memory_monitor..."
   LD_PRELOAD="$MONITOR_LIB" ./tests/"$TEST" > "monitor_${TEST}.out" 2>&1
@@ -45,4 +57,197 @@ for TEST in "${TESTS[@]}"; do
   echo
 done
 
+# Zapis migawek do pliku pierścieniowego i jego odczyt
+echo "Uruchamianie test_mmap z plikiem pierścieniowym..."
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_RING="monitor_ring.ring" MEMORY_MONITOR_RING_INTERVAL_MS=10 MEMORY_MONITOR_OVERHEAD=1 \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_mmap > monitor_ring.out 2>&1
+if ! ./src/memory_ring_reader monitor_ring.ring > monitor_ring.csv; then
+  echo "Odczyt pliku pierścieniowego zakończył się błędem."
+fi
+echo "Zapisano: monitor_ring.out i monitor_ring.csv"
+
+# Procesy potomne (fork oraz exec) nie mogą przejąć pliku pierścieniowego rodzica
+echo "Uruchamianie test_ring_fork z plikiem pierścieniowym..."
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_RING="monitor_ring_fork.ring" MEMORY_MONITOR_RING_INTERVAL_MS=10 \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_ring_fork > monitor_ring_fork.out 2>&1
+if [ $? -ne 0 ]; then
+  echo "Test test_ring_fork z memory_monitor zakończył się błędem."
+fi
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_RING="monitor_ring_fork_%p.ring" MEMORY_MONITOR_RING_INTERVAL_MS=10 \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_ring_fork > monitor_ring_fork_pid.out 2>&1
+parent=$(sed -n 's/^ring: per-process path, pid=//p' monitor_ring_fork_pid.out)
+if [ -z "$parent" ] || ! ./src/memory_ring_reader "monitor_ring_fork_${parent}.ring" > /dev/null; then
+  echo "Plik pierścieniowy z %p nie został zapisany dla procesu rodzica."
+fi
+rm -f monitor_ring_fork_*.ring
+echo "Zapisano: monitor_ring_fork.out i monitor_ring_fork_pid.out"
+
+# Udostępnianie metryk przez gniazdo domeny Unix
+echo "Uruchamianie test_metrics z gniazdem metryk..."
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_METRICS_SOCKET="monitor_metrics.sock" \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_metrics > monitor_metrics.out 2>&1
+if [ $? -ne 0 ]; then
+  echo "Test test_metrics z memory_monitor zakończył się błędem."
+fi
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_DEFER_FREE=1 MEMORY_MONITOR_METRICS_SOCKET="monitor_metrics_defer.sock" \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_metrics > monitor_metrics_defer.out 2>&1
+if [ $? -ne 0 ]; then
+  echo "Test test_metrics z odroczonym zwalnianiem zakończył się błędem."
+fi
+echo "Zapisano: monitor_metrics.out i monitor_metrics_defer.out"
+
+# Odroczone, grupowe zwalnianie pamięci
+echo "Uruchamianie test_threads z odroczonym zwalnianiem..."
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_DEFER_FREE=1 \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_threads > monitor_defer_free.out 2>&1
+if [ $? -ne 0 ]; then
+  echo "Test test_threads z odroczonym zwalnianiem zakończył się błędem."
+fi
+if ! grep -q "^\[threads\] cross-thread frees" monitor_defer_free.out; then
+  echo "Raport zwolnień między wątkami nie został wypisany."
+fi
+echo "Zapisano: monitor_defer_free.out"
+
+# Wykrywanie podwójnego zwolnienia (kontynuacja oraz przerwanie procesu)
+echo "Uruchamianie test_invalid_free z memory_monitor..."
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_FREE_STACKS=1 \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_invalid_free > monitor_invalid_free.out 2>&1
+if [ $? -ne 0 ]; then
+  echo "Test test_invalid_free z memory_monitor zakończył się błędem."
+fi
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_FREE_STACKS=1 MEMORY_MONITOR_DEFER_FREE=1 \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_invalid_free > monitor_invalid_free_defer.out 2>&1
+if [ $? -ne 0 ] || ! grep -q "^\[bad free\]   #0 .*(test_invalid_free+" monitor_invalid_free_defer.out; then
+  echo "Stos pierwszego zwolnienia nie został zapisany przy odroczonym zwalnianiu."
+fi
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_BAD_FREE=abort \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_invalid_free > monitor_invalid_free_abort.out 2>&1
+if [ $? -eq 0 ]; then
+  echo "Test test_invalid_free z MEMORY_MONITOR_BAD_FREE=abort nie przerwał procesu."
+fi
+echo "Zapisano: monitor_invalid_free.out, monitor_invalid_free_defer.out i monitor_invalid_free_abort.out"
+
+# Próbkowane alokacje ze stronami ochronnymi (przepełnienie i użycie po zwolnieniu)
+echo "Uruchamianie test_guarded z memory_monitor..."
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_GUARD_SAMPLE=1 \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_guarded > monitor_guarded.out 2>&1
+if [ $? -ne 0 ]; then
+  echo "Test test_guarded z memory_monitor zakończył się błędem."
+fi
+for mode in overflow uaf; do
+  MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_GUARD_SAMPLE=1 \
+    LD_PRELOAD="$MONITOR_LIB" ./tests/test_guarded "$mode" > "monitor_guarded_$mode.out" 2>&1
+  if [ $? -eq 0 ] || ! grep -q "^\[guard\] \(heap-buffer-overflow\|use-after-free\)" "monitor_guarded_$mode.out"; then
+    echo "Test test_guarded $mode nie został wykryty przez memory_monitor."
+  fi
+done
+# Bloki z puli ochronnej pominięte przez filtr rozmiaru (realloc musi zachować zawartość)
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_GUARD_SAMPLE=1 MEMORY_MONITOR_FILTER_MIN_SIZE=4096 \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_guarded > monitor_guarded_filter.out 2>&1
+if [ $? -ne 0 ]; then
+  echo "Test test_guarded z filtrem rozmiaru zakończył się błędem."
+fi
+echo "Zapisano: monitor_guarded.out, monitor_guarded_overflow.out, monitor_guarded_uaf.out i monitor_guarded_filter.out"
+
+# Próbkowanie rozmieszczenia stron dużych bloków na węzłach NUMA
+echo "Uruchamianie test_numa z próbkowaniem NUMA..."
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_NUMA=1 MEMORY_MONITOR_NUMA_INTERVAL_MS=10 \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_numa > monitor_numa.out 2>&1
+if [ $? -ne 0 ]; then
+  echo "Test test_numa z memory_monitor zakończył się błędem."
+fi
+if ! grep -q "^\[numa\] node [0-9]*: " monitor_numa.out; then
+  echo "Raport rozmieszczenia NUMA nie został wypisany."
+fi
+echo "Zapisano: monitor_numa.out"
+
+# Szczyt zużycia pamięci i największe bloki w chwili szczytu
+echo "Uruchamianie test_peak..."
+MEMORY_MONITOR_LOG=0 LD_PRELOAD="$MONITOR_LIB" ./tests/test_peak > monitor_peak.out 2>&1
+if [ $? -ne 0 ]; then
+  echo "Test test_peak z memory_monitor zakończył się błędem."
+fi
+if ! grep -q "^\[peak\] block #1 .* size=150000 " monitor_peak.out || ! grep -q "^\[peak\] block #16 .* size=9000 " monitor_peak.out; then
+  echo "Raport szczytu zużycia pamięci nie został wypisany lub pominął największe bloki."
+fi
+echo "Zapisano: monitor_peak.out"
+
+# Filtry śledzenia: rozmiar i moduł wywołującego
+echo "Uruchamianie test_filter z filtrami śledzenia..."
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_FILTER_MIN_SIZE=4096 \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_filter > monitor_filter.out 2>&1
+if [ $? -ne 0 ]; then
+  echo "Test test_filter z memory_monitor zakończył się błędem."
+fi
+if ! grep -q "^\[filter\] [1-9][0-9]* allocations were not tracked" monitor_filter.out || grep -q "^\[bad free\]" monitor_filter.out; then
+  echo "Filtr rozmiaru nie pominął małych bloków lub zgłosił ich zwolnienia."
+fi
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_FILTER_EXCLUDE_MODULES=test_filter \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_filter > monitor_filter_module.out 2>&1
+if [ $? -ne 0 ] || grep -q "^\[peak\] block .*(test_filter+" monitor_filter_module.out; then
+  echo "Filtr modułu nie pominął alokacji z test_filter."
+fi
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_FILTER_MIN_SIZE=64 \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_filter double > monitor_filter_double.out 2>&1
+if [ $? -ne 0 ] || [ "$(grep -c "^\[bad free\] double free" monitor_filter_double.out)" -ne 1 ] ||
+   grep -q "^\[bad free\] free of untracked" monitor_filter_double.out; then
+  echo "Podwójne zwolnienie śledzonego bloku przy aktywnym filtrze nie zostało wykryte."
+fi
+# Bez tcache i z jedną areną wątki od razu dostają adresy zwolnione przez inne wątki
+GLIBC_TUNABLES=glibc.malloc.tcache_count=0:glibc.malloc.arena_max=1 MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_FILTER_MIN_SIZE=64 \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_filter realloc > monitor_filter_realloc.out 2>&1
+if [ $? -ne 0 ] || grep -q "^\[bad free\]" monitor_filter_realloc.out; then
+  echo "Adres zwolniony przez realloc i ponownie przydzielony bez śledzenia został zgłoszony jako błędne zwolnienie."
+fi
+echo "Zapisano: monitor_filter.out, monitor_filter_module.out, monitor_filter_double.out i monitor_filter_realloc.out"
+
+# Funkcje alokacji z wyrównaniem, reallocarray, mremap i brk
+echo "Uruchamianie test_aligned..."
+LD_PRELOAD="$MONITOR_LIB" ./tests/test_aligned > monitor_aligned.out 2>&1
+if [ $? -ne 0 ]; then
+  echo "Test test_aligned z memory_monitor zakończył się błędem."
+fi
+if ! grep -q "^\[posix_memalign\] " monitor_aligned.out || ! grep -q "^\[mremap\] " monitor_aligned.out ||
+   ! grep -q "^Final state - .* mmap_alloc=0 bytes" monitor_aligned.out || grep -q "^\[bad free\]" monitor_aligned.out; then
+  echo "Alokacje z wyrównaniem lub mremap nie zostały poprawnie rozliczone."
+fi
+echo "Zapisano: monitor_aligned.out"
+
+# Program C++: alokacje przed inicjalizacją biblioteki oraz operatory new i delete
+echo "Uruchamianie test_cxx..."
+LD_PRELOAD="$MONITOR_LIB" ./tests/test_cxx > monitor_cxx.out 2>&1
+if [ $? -ne 0 ]; then
+  echo "Test test_cxx z memory_monitor zakończył się błędem."
+fi
+if ! grep -q "^\[new\] size=3000 " monitor_cxx.out || ! grep -q "^\[new\] size=5000 " monitor_cxx.out ||
+   ! grep -q "^\[delete\] ptr=" monitor_cxx.out || grep -q "^\[bad free\]" monitor_cxx.out ||
+   ! grep -q "^Final state - malloc_alloc=76800 bytes" monitor_cxx.out; then
+  echo "Operatory new i delete nie zostały poprawnie rozliczone."
+fi
+echo "Zapisano: monitor_cxx.out"
+
+# Operator delete w trybie odroczonego zwalniania korzysta z tych samych partii co free
+echo "Uruchamianie test_cxx z odroczonym zwalnianiem..."
+MEMORY_MONITOR_DEFER_FREE=1 LD_PRELOAD="$MONITOR_LIB" ./tests/test_cxx > monitor_cxx_defer.out 2>&1
+if [ $? -ne 0 ]; then
+  echo "Test test_cxx z odroczonym zwalnianiem zakończył się błędem."
+fi
+if ! grep -q "^\[delete\] ptr=.* | deferred" monitor_cxx_defer.out || grep -q "^\[bad free\]" monitor_cxx_defer.out ||
+   ! grep -q "^Final state - malloc_alloc=76800 bytes" monitor_cxx_defer.out; then
+  echo "Operator delete nie został odroczony lub rozliczony."
+fi
+echo "Zapisano: monitor_cxx_defer.out"
+
+# Pomiar narzutu samej biblioteki (liczniki perf_event lub znaczniki czasu)
+echo "Uruchamianie test_threads z pomiarem narzutu..."
+MEMORY_MONITOR_LOG=0 MEMORY_MONITOR_OVERHEAD=1 \
+  LD_PRELOAD="$MONITOR_LIB" ./tests/test_threads > monitor_overhead.out 2>&1
+if [ $? -ne 0 ]; then
+  echo "Test test_threads z pomiarem narzutu zakończył się błędem."
+fi
+if ! grep -q "^\[overhead\] free calls=" monitor_overhead.out; then
+  echo "Raport narzutu biblioteki nie został wypisany."
+fi
+echo "Zapisano: monitor_overhead.out"
+
 echo "Można teraz porównać dane (mallinfo) z plików monitor_*.out z logami wywołań systemowych w strace_*.txt."
@@ -16,8 +16,27 @@
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <limits.h>
+#include <execinfo.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <linux/perf_event.h>
+
+#include "memory_monitor_ring.h"
 
 /**
  * @brief Pointer to the original malloc function from the standard library.
@@ -63,6 +82,84 @@ static void *(*real_dlopen)(const char *, int) = NULL;
  * @brief Pointer to the original dlclose function.
  */
 static int   (*real_dlclose)(void *) = NULL;
+/**
+ * @brief Pointer to the original posix_memalign function.
+ */
+static int   (*real_posix_memalign)(void **, size_t, size_t) = NULL;
+/**
+ * @brief Pointer to the original aligned_alloc function.
+ */
+static void *(*real_aligned_alloc)(size_t, size_t) = NULL;
+/**
+ * @brief Pointer to the original memalign function.
+ */
+static void *(*real_memalign)(size_t, size_t) = NULL;
+/**
+ * @brief Pointer to the original valloc function.
+ */
+static void *(*real_valloc)(size_t) = NULL;
+/**
+ * @brief Pointer to the original pvalloc function.
+ */
+static void *(*real_pvalloc)(size_t) = NULL;
+/**
+ * @brief Pointer to the original mremap function.
+ */
+static void *(*real_mremap)(void *, size_t, size_t, int, ...) = NULL;
+/**
+ * @brief Pointer to the original brk function.
+ */
+static int   (*real_brk)(void *) = NULL;
+/**
+ * @brief Pointer to the original malloc_usable_size function.
+ */
+static size_t (*real_malloc_usable_size)(void *) = NULL;
+
+/**
+ * @brief Size of the static arena serving allocations made before the original functions are resolved.
+ */
+#define BOOTSTRAP_ARENA_SIZE (64 * 1024)
+/**
+ * @brief Bootstrap arena. Blocks are preceded by their size and are never reused.
+ */
+static _Alignas(64) char bootstrap_arena[BOOTSTRAP_ARENA_SIZE];
+/**
+ * @brief Bytes of bootstrap_arena handed out so far.
+ */
+static _Atomic size_t bootstrap_used = 0;
+/**
+ * @brief Symbol resolution states of ensure_init().
+ */
+enum { INIT_NONE, INIT_RESOLVING, INIT_DONE };
+/**
+ * @brief Symbol resolution state (INIT_*).
+ */
+static atomic_int init_state = INIT_NONE;
+
+/**
+ * @brief C++ allocation operators whose originals are called by the interposers.
+ *
+ * The nothrow variants of each operator follow the throwing ones at a
+ * distance of 2. The deletes are not called: every original delete only
+ * hands the block to free, so the delete interposers release blocks the
+ * way free does (see cxx_delete()).
+ */
+enum {
+    CXX_NEW, CXX_NEW_ARRAY, CXX_NEW_NOTHROW, CXX_NEW_ARRAY_NOTHROW,
+    CXX_NEW_ALIGNED, CXX_NEW_ARRAY_ALIGNED, CXX_NEW_ALIGNED_NOTHROW, CXX_NEW_ARRAY_ALIGNED_NOTHROW,
+    CXX_OPERATORS
+};
+/**
+ * @brief Mangled names of the C++ operators, indexed by CXX_*.
+ */
+static const char *const cxx_operator_names[CXX_OPERATORS] = {
+    "_Znwm", "_Znam", "_ZnwmRKSt9nothrow_t", "_ZnamRKSt9nothrow_t",
+    "_ZnwmSt11align_val_t", "_ZnamSt11align_val_t", "_ZnwmSt11align_val_tRKSt9nothrow_t", "_ZnamSt11align_val_tRKSt9nothrow_t",
+};
+/**
+ * @brief Original C++ operators, resolved on first use (libstdc++ may be loaded by dlopen).
+ */
+static void *_Atomic real_cxx_operators[CXX_OPERATORS];
 
 /**
  * @brief Utility function to print memory usage.
@@ -80,126 +177,4274 @@ static void printUsage();
  */
 static void safe_log(const char *format, ...);
 
+/**
+ * @brief Reconciles the deferred frees of all threads with the allocation table.
+ *
+ * Called before every report or snapshot so the counters are exact.
+ */
+static void flush_free_batches();
+
+/**
+ * @brief Reconciles the calling thread's deferred frees before its thread slot is released.
+ */
+static void free_batch_release_slot();
+
+/**
+ * @brief Reads a numeric configuration value from the environment.
+ *
+ * @param name Name of the environment variable.
+ * @param fallback Value returned when the variable is unset or invalid.
+ * @return The parsed value or @p fallback.
+ */
+static unsigned long env_number(const char *name, unsigned long fallback);
+
 /**
  * @brief Global variable tracking the total amount of memory allocated via mmap.
  */
-static size_t total_mmap_alloc = 0;
+static _Atomic size_t total_mmap_alloc = 0;
 /**
  * @brief Global variable tracking the total amount of memory deallocated via munmap.
  */
-static size_t total_mmap_dealloc = 0;
+static _Atomic size_t total_mmap_dealloc = 0;
+
+/**
+ * @brief Number of slots in the call site table (power of two).
+ */
+#define SITE_TABLE_SIZE 1024
+
+/**
+ * @struct Site
+ * @brief Aggregated statistics of a single allocation call site.
+ *
+ * A call site is identified by the return address of the intercepted call.
+ */
+typedef struct Site {
+    void *addr;                 /**< Return address of the allocating call (NULL for the overflow site). */
+    size_t live_bytes;          /**< Bytes currently allocated from this site. */
+    uint64_t live_blocks;       /**< Blocks currently allocated from this site. */
+    uint64_t allocations;       /**< Total number of allocations made from this site. */
+    uint64_t reallocs;          /**< Number of realloc calls made from this site. */
+    uint64_t realloc_moves;     /**< Reallocs that moved the block to a new address. */
+    uint64_t small_growths;     /**< Reallocs that grew a block by less than half of its size. */
+    uint64_t max_chain;         /**< Most reallocs applied to a single block from this site. */
+    size_t bytes_copied;        /**< Bytes copied by reallocs that moved the block. */
+    size_t grown_from;          /**< Sum of the old sizes of growing reallocs. */
+    size_t grown_to;            /**< Sum of the new sizes of growing reallocs. */
+    unsigned heap_index;        /**< Position in site_heap plus one (0 if not in it). */
+} Site;
+
+/**
+ * @brief log2 of the initial number of slots in the allocation table.
+ */
+#define ALLOCATION_TABLE_INITIAL_BITS 12
+
+/**
+ * @brief A block that grew this many times with small increments is reported as a reserve candidate.
+ */
+#define REALLOC_CHAIN_THRESHOLD 8
+
+/**
+ * @brief Number of sites listed in the realloc report.
+ */
+#define REALLOC_REPORT_SITES 10
 
 /**
  * @struct Allocation
  * @brief Structure for tracking memory allocations from malloc/calloc/realloc.
  *
- * Stores a pointer to the allocated memory block, its size,
- * and a pointer to the next element in the singly-linked list.
+ * Stores a pointer to the allocated memory block, its size, its call site,
+ * the thread that allocated it and how many times it was resized. Entries live directly in the
+ * open-addressing allocation table; a NULL ptr marks an empty slot.
  */
 typedef struct Allocation {
     void *ptr;                  /**< Pointer to the allocated memory block. */
     size_t size;                /**< Size of the allocated memory block. */
-    struct Allocation *next;    /**< Pointer to the next list element. */
+    Site *site;                 /**< Call site that allocated (or last resized) the block. */
+    uint32_t reallocs;          /**< Number of reallocs applied to the block. */
+    uint32_t thread;            /**< Thread slot of the thread that owns the block. */
+    size_t heap_index;          /**< Position in block_heap plus one (0 if not a member). */
 } Allocation;
- 
+
 /**
- * @brief Head of the Allocation list that stores all current allocations from malloc/calloc/realloc.
+ * @brief Open-addressing (linear probing) table of all current allocations from malloc/calloc/realloc.
+ *
+ * The table is mapped with real_mmap and doubled when it becomes half full.
+ */
+static Allocation *allocations = NULL;
+/**
+ * @brief log2 of the number of slots in the allocation table.
  */
-static Allocation *allocations_head = NULL;
+static unsigned allocation_bits = 0;
 
 /**
- * @brief Mutex that protects the Allocation list.
+ * @brief Mutex that protects the allocation table and the counters.
  */
 static pthread_mutex_t alloc_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /**
- * @brief Global variable tracking the total amount of memory allocated by malloc/calloc/realloc.
+ * @brief Number of thread slots; when THREAD_SLOTS - 1 threads hold a slot, further threads share the last one.
  */
-static size_t total_malloc_alloc = 0;
+#define THREAD_SLOTS 64
 
 /**
- * @brief Thread-safe logging function to stderr.
+ * @brief Number of producer/consumer pairs listed in the cross-thread free report.
+ */
+#define THREAD_REPORT_PAIRS 10
+
+/**
+ * @struct ThreadStats
+ * @brief Allocation statistics of one thread slot (protected by alloc_lock).
  *
- * Logs events in the library (allocations, deallocations, etc.) in a thread-safe manner.
+ * A slot is recycled for a new thread once its thread has exited and
+ * every block it allocated has been freed, so blocks leaked by an exited
+ * thread stay attributed to it.
+ */
+typedef struct ThreadStats {
+    pid_t tid;                  /**< Kernel thread ID (0 for the shared slot). */
+    uint64_t start_ns;          /**< CLOCK_MONOTONIC time of the thread's first tracked call. */
+    uint64_t exit_ns;           /**< CLOCK_MONOTONIC time of the thread's exit (0 while it runs). */
+    size_t live_bytes;          /**< Bytes currently owned by the thread. */
+    uint64_t live_blocks;       /**< Blocks currently owned by the thread. */
+    uint64_t allocations;       /**< Blocks created by the thread (malloc, calloc and moving realloc). */
+    int released;               /**< Whether the slot is waiting in thread_free_slots. */
+} ThreadStats;
+
+/**
+ * @struct ThreadPair
+ * @brief Number of blocks allocated by one thread and freed by another, used for reports.
+ */
+typedef struct ThreadPair {
+    unsigned producer;          /**< Thread slot that allocated the blocks. */
+    unsigned consumer;          /**< Thread slot that freed the blocks. */
+    uint64_t frees;             /**< Number of such frees. */
+} ThreadPair;
+
+/**
+ * @brief Statistics of all thread slots.
+ */
+static ThreadStats thread_stats[THREAD_SLOTS];
+/**
+ * @brief Number of distinct thread slots handed out (at most THREAD_SLOTS; the last one is shared).
+ */
+static _Atomic unsigned thread_slots_used = 0;
+/**
+ * @brief Slots released by exited threads, reused before new ones are handed out (protected by alloc_lock).
+ */
+static unsigned thread_free_slots[THREAD_SLOTS];
+/**
+ * @brief Number of entries in thread_free_slots (protected by alloc_lock).
+ */
+static unsigned thread_free_slot_count = 0;
+/**
+ * @brief Number of threads that used the allocator (protected by alloc_lock).
+ */
+static uint64_t threads_started = 0;
+/**
+ * @brief Free matrix: thread_frees[consumer][producer] counts blocks allocated by producer and freed by consumer.
  *
- * @param format Format string (printf-style).
- * @param ... Additional arguments.
+ * A free is counted with a relaxed atomic increment in the row of the
+ * freeing thread, under the alloc_lock section that removes the block, so
+ * the producer's slot cannot be recycled (and its column cleared) between
+ * the two. Rows are cache-line aligned, so readers scanning the matrix do
+ * not contend with writers of other rows. Deferred frees
+ * (MEMORY_MONITOR_DEFER_FREE=1) are counted in the row of the thread that
+ * buffered them by whichever thread reconciles the batch (the owner, the
+ * ring thread, the final reports). The diagonal counts local frees.
  */
-static void safe_log(const char *format, ...) {
-    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
-    va_list args;
+static _Atomic uint64_t thread_frees[THREAD_SLOTS][THREAD_SLOTS] __attribute__((aligned(64)));
+/**
+ * @brief Thread slot of the calling thread plus one (0 until first use).
+ */
+static __thread unsigned thread_slot __attribute__((tls_model("initial-exec"))) = 0;
+/**
+ * @brief Key whose destructor records the exit time of a thread and releases its slot.
+ */
+static pthread_key_t thread_exit_key;
+/**
+ * @brief Whether thread_exit_key was created.
+ */
+static int thread_exit_key_ready = 0;
 
-    pthread_mutex_lock(&lock);
-    va_start(args, format);
-    vfprintf(stderr, format, args);
-    va_end(args);
-    pthread_mutex_unlock(&lock);
+/**
+ * @brief Number of hardware counters sampled per measurement (cycles, instructions, cache misses).
+ */
+#define OVERHEAD_COUNTERS 3
+
+/**
+ * @brief Measurement states of a thread.
+ */
+enum { OVERHEAD_UNSET, OVERHEAD_ACTIVE, OVERHEAD_DISABLED };
+
+/**
+ * @struct OverheadThread
+ * @brief Per-thread self-overhead counters.
+ *
+ * A measured call alternates between segments spent in the library and
+ * segments spent in real_* functions; the counters are sampled at every
+ * boundary. Only the owner thread writes the totals, reporters read them
+ * with relaxed atomics.
+ */
+typedef struct OverheadThread {
+    int state;                                                          /**< OVERHEAD_UNSET, OVERHEAD_ACTIVE or OVERHEAD_DISABLED. */
+    int registered;                                                     /**< Whether the thread is in the overhead_threads list. */
+    int depth;                                                          /**< Nesting of measured interposers (only the outermost is measured). */
+    int fds[OVERHEAD_COUNTERS];                                         /**< perf_event file descriptors (cycles mode). */
+    struct perf_event_mmap_page *pages[OVERHEAD_COUNTERS];              /**< perf_event control pages read by rdpmc. */
+    uint64_t mark[OVERHEAD_COUNTERS];                                   /**< Counter values at the start of the current segment. */
+    uint64_t self[OVERHEAD_COUNTERS];                                   /**< Library cost of the current call so far. */
+    uint64_t real[OVERHEAD_COUNTERS];                                   /**< real_* cost of the current call so far. */
+    _Atomic uint64_t calls[MM_OVERHEAD_OPS];                            /**< Measured calls per operation type. */
+    _Atomic uint64_t self_total[MM_OVERHEAD_OPS][OVERHEAD_COUNTERS];    /**< Library cost per operation type. */
+    _Atomic uint64_t real_total[MM_OVERHEAD_OPS][OVERHEAD_COUNTERS];    /**< real_* cost per operation type. */
+    struct OverheadThread *next;                                        /**< Next registered thread. */
+} OverheadThread;
+
+/**
+ * @struct OverheadTotals
+ * @brief Self-overhead counters summed over all threads.
+ */
+typedef struct OverheadTotals {
+    uint64_t calls[MM_OVERHEAD_OPS];                            /**< Measured calls per operation type. */
+    uint64_t self[MM_OVERHEAD_OPS][OVERHEAD_COUNTERS];          /**< Library cost per operation type. */
+    uint64_t real[MM_OVERHEAD_OPS][OVERHEAD_COUNTERS];          /**< real_* cost per operation type. */
+} OverheadTotals;
+
+/**
+ * @brief Measurement unit: MM_OVERHEAD_OFF, MM_OVERHEAD_CYCLES (rdpmc) or MM_OVERHEAD_NS (clock fallback).
+ */
+static int overhead_mode = MM_OVERHEAD_OFF;
+/**
+ * @brief Why the PMU could not be used (logged with the clock fallback).
+ */
+static char overhead_fallback_reason[64];
+/**
+ * @brief Overhead counters of the calling thread.
+ */
+static __thread OverheadThread overhead_thread __attribute__((tls_model("initial-exec")));
+/**
+ * @brief List of threads with overhead counters.
+ */
+static OverheadThread *overhead_threads = NULL;
+/**
+ * @brief Counters of threads that already exited.
+ */
+static OverheadTotals overhead_exited;
+/**
+ * @brief Number of threads that could not open their counters and are not measured.
+ */
+static uint64_t overhead_unmeasured = 0;
+/**
+ * @brief Mutex that protects overhead_threads and overhead_exited.
+ */
+static pthread_mutex_t overhead_lock = PTHREAD_MUTEX_INITIALIZER;
+/**
+ * @brief Key whose destructor folds a thread's counters into overhead_exited.
+ */
+static pthread_key_t overhead_key;
+
+/**
+ * @brief Number of frees a thread buffers before reconciling them (at most 64).
+ */
+#define FREE_BATCH_SIZE 64
+
+/**
+ * @brief Number of table slots prefetched together while reconciling a batch.
+ */
+#define FREE_PREFETCH_GROUP 8
+
+/**
+ * @brief Number of stack frames recorded per free with MEMORY_MONITOR_FREE_STACKS=1.
+ */
+#define FREE_STACK_DEPTH 8
+
+/**
+ * @struct FreeStack
+ * @brief Stack of a free call, captured before alloc_lock is taken.
+ */
+typedef struct FreeStack {
+    int depth;                          /**< Number of valid frames (0 unless MEMORY_MONITOR_FREE_STACKS=1). */
+    void *frames[FREE_STACK_DEPTH];     /**< Frames, starting at the program's call into the library. */
+} FreeStack;
+
+/**
+ * @struct FreeBatch
+ * @brief Thread-local buffer of frees not yet reconciled with the allocation table.
+ *
+ * The blocks are handed to real_free only when the batch is flushed, so
+ * their addresses cannot be reused while their entries are still in the
+ * table. The owner thread and reporters flushing all batches synchronize
+ * on the per-batch lock, which is practically never contended.
+ */
+typedef struct FreeBatch {
+    pthread_mutex_t lock;               /**< Protects count and ptrs. */
+    size_t count;                       /**< Number of buffered frees. */
+    unsigned thread;                    /**< Thread slot of the owner thread. */
+    int registered;                     /**< Whether the batch is in the free_batches list. */
+    int exited;                         /**< Set once the owner thread's exit destructor ran. */
+    struct FreeBatch *next;             /**< Next registered batch. */
+    void *ptrs[FREE_BATCH_SIZE];        /**< Buffered pointers. */
+    void *callers[FREE_BATCH_SIZE];     /**< Return addresses of the buffered free calls. */
+    FreeStack stacks[FREE_BATCH_SIZE];  /**< Stacks of the buffered free calls. */
+} FreeBatch;
+
+/**
+ * @brief Whether frees are buffered per thread and reconciled in batches (MEMORY_MONITOR_DEFER_FREE=1).
+ */
+static int defer_frees = 0;
+/**
+ * @brief Free batch of the calling thread.
+ */
+static __thread FreeBatch free_batch __attribute__((tls_model("initial-exec"))) = { .lock = PTHREAD_MUTEX_INITIALIZER };
+/**
+ * @brief List of the free batches of all threads that deferred a free.
+ */
+static FreeBatch *free_batches = NULL;
+/**
+ * @brief Mutex that protects the free_batches list.
+ */
+static pthread_mutex_t free_batches_lock = PTHREAD_MUTEX_INITIALIZER;
+/**
+ * @brief Key whose destructor flushes a thread's batch when the thread exits.
+ */
+static pthread_key_t free_batch_key;
+
+/**
+ * @brief log2 of the number of counters in the membership filter.
+ */
+#define MEMBERSHIP_BITS 20
+
+/**
+ * @brief Number of recent frees remembered for double-free reports.
+ */
+#define FREED_HISTORY_SIZE 4096
+
+/**
+ * @brief log2 of the number of counters in the recently freed filter.
+ */
+#define FREED_FILTER_BITS 16
+
+/**
+ * @brief Counting filter over tracked pointers, readable without alloc_lock.
+ *
+ * Each tracked pointer increments the counter its hash selects (under
+ * alloc_lock). A zero counter proves the pointer is not tracked, so
+ * invalid and double frees are recognized with a single load. Saturated
+ * counters stay saturated.
+ */
+static _Atomic unsigned char membership[1 << MEMBERSHIP_BITS];
+/**
+ * @brief Counting filter over the pointers in freed_history, readable without alloc_lock.
+ *
+ * While tracking filters are active, frees and allocations of untracked
+ * pointers consult it so they only take alloc_lock when the pointer may
+ * be in the history.
+ */
+static _Atomic unsigned char freed_filter[1 << FREED_FILTER_BITS];
+
+/**
+ * @struct FreedBlock
+ * @brief A recently freed pointer, kept to describe the original free of a double free.
+ */
+typedef struct FreedBlock {
+    void *ptr;                          /**< The freed pointer. */
+    void *caller;                       /**< Return address of the free call. */
+    pid_t tid;                          /**< Thread that freed the block. */
+    FreeStack stack;                    /**< Stack of the free (MEMORY_MONITOR_FREE_STACKS=1). */
+} FreedBlock;
+
+/**
+ * @brief Ring of the most recent frees (protected by alloc_lock).
+ */
+static FreedBlock freed_history[FREED_HISTORY_SIZE];
+/**
+ * @brief Total number of frees written to freed_history.
+ */
+static uint64_t freed_history_count = 0;
+/**
+ * @brief Whether stacks of frees are recorded (MEMORY_MONITOR_FREE_STACKS=1).
+ */
+static int free_stacks = 0;
+/**
+ * @brief Whether an invalid or double free aborts the process (MEMORY_MONITOR_BAD_FREE=abort).
+ */
+static int bad_free_abort = 0;
+/**
+ * @brief Number of detected double frees.
+ */
+static uint64_t double_frees = 0;
+/**
+ * @brief Number of detected frees of pointers that were never tracked.
+ */
+static uint64_t invalid_frees = 0;
+
+/**
+ * @brief Maximum number of entries in a module or site filter list.
+ */
+#define FILTER_LIST_MAX 16
+/**
+ * @brief Maximum length of a module name in a filter list.
+ */
+#define FILTER_NAME_MAX 64
+/**
+ * @brief log2 of the number of slots in the per-call-site filter decision cache.
+ */
+#define FILTER_CACHE_BITS 12
+/**
+ * @brief Slots probed in the decision cache before a decision is left uncached.
+ */
+#define FILTER_CACHE_PROBES 8
+/**
+ * @brief Bit of a decision cache entry set when the call site is tracked.
+ */
+#define FILTER_TRACKED ((uintptr_t)1 << (sizeof(uintptr_t) * 8 - 1))
+
+/**
+ * @struct FilterList
+ * @brief A list of module names or site hashes parsed from a comma-separated variable.
+ */
+typedef struct FilterList {
+    unsigned count;                                 /**< Number of valid entries. */
+    char modules[FILTER_LIST_MAX][FILTER_NAME_MAX]; /**< Module file names (module lists). */
+    uint64_t hashes[FILTER_LIST_MAX];               /**< Site hashes (site lists). */
+} FilterList;
+
+/**
+ * @brief Whether any tracking filter is configured.
+ */
+static int filters_enabled = 0;
+/**
+ * @brief Smallest tracked allocation size (MEMORY_MONITOR_FILTER_MIN_SIZE).
+ */
+static size_t filter_min_size = 0;
+/**
+ * @brief Largest tracked allocation size (MEMORY_MONITOR_FILTER_MAX_SIZE).
+ */
+static size_t filter_max_size = SIZE_MAX;
+/**
+ * @brief Whether a module or site list is configured, so call sites must be resolved.
+ */
+static int filter_by_site = 0;
+/**
+ * @brief Modules whose allocations are tracked (MEMORY_MONITOR_FILTER_MODULES, empty = all).
+ */
+static FilterList filter_modules;
+/**
+ * @brief Modules whose allocations are not tracked (MEMORY_MONITOR_FILTER_EXCLUDE_MODULES).
+ */
+static FilterList filter_exclude_modules;
+/**
+ * @brief Site hashes whose allocations are tracked (MEMORY_MONITOR_FILTER_SITES, empty = all).
+ */
+static FilterList filter_sites;
+/**
+ * @brief Site hashes whose allocations are not tracked (MEMORY_MONITOR_FILTER_EXCLUDE_SITES).
+ */
+static FilterList filter_exclude_sites;
+/**
+ * @brief Decisions per return address: the address, with FILTER_TRACKED set if it is tracked (0 = empty).
+ */
+static _Atomic uintptr_t filter_cache[1 << FILTER_CACHE_BITS];
+/**
+ * @brief Number of allocations skipped by the filters.
+ */
+static _Atomic uint64_t filtered_allocations = 0;
+/**
+ * @brief Number of stack frames recorded for the allocation and free of a guarded block.
+ */
+#define GUARD_STACK_DEPTH 8
+
+/**
+ * @brief Slot states of the guarded pool.
+ */
+enum { GUARD_SLOT_UNUSED, GUARD_SLOT_LIVE, GUARD_SLOT_FREED };
+
+/**
+ * @struct GuardSlot
+ * @brief Metadata of one slot of the guarded pool.
+ *
+ * Each slot is a single page between two PROT_NONE guard pages. The block
+ * is right-aligned against the following guard page, so an overflow faults
+ * immediately; after free the page is made PROT_NONE and quarantined.
+ */
+typedef struct GuardSlot {
+    uintptr_t ptr;                          /**< Start of the block. */
+    size_t size;                            /**< Requested size of the block. */
+    int state;                              /**< GUARD_SLOT_UNUSED, GUARD_SLOT_LIVE or GUARD_SLOT_FREED. */
+    pid_t alloc_tid;                        /**< Thread that allocated the block. */
+    pid_t free_tid;                         /**< Thread that freed the block. */
+    int alloc_depth;                        /**< Valid frames in alloc_stack. */
+    int free_depth;                         /**< Valid frames in free_stack. */
+    void *alloc_stack[GUARD_STACK_DEPTH];   /**< Stack of the allocation (starting at the call site). */
+    void *free_stack[GUARD_STACK_DEPTH];    /**< Stack of the free (starting at the call site). */
+} GuardSlot;
+
+/**
+ * @brief Average number of allocations between two guarded ones (MEMORY_MONITOR_GUARD_SAMPLE, 0 = off).
+ */
+static unsigned long guard_sample_rate = 0;
+/**
+ * @brief Number of slots in the guarded pool (MEMORY_MONITOR_GUARD_SLOTS).
+ */
+static size_t guard_slot_count = 0;
+/**
+ * @brief Page size, which is also the largest guarded allocation.
+ */
+static size_t guard_page_size = 0;
+/**
+ * @brief Start of the guarded pool (2 * guard_slot_count + 1 pages).
+ */
+static uintptr_t guard_pool_start = 0;
+/**
+ * @brief End of the guarded pool.
+ */
+static uintptr_t guard_pool_end = 0;
+/**
+ * @brief Slot metadata, mapped with real_mmap.
+ */
+static GuardSlot *guard_slots = NULL;
+/**
+ * @brief Next slot to consider; slots are reused round-robin so freed ones stay quarantined longest.
+ */
+static size_t guard_next_slot = 0;
+/**
+ * @brief Number of allocations served from the guarded pool.
+ */
+static uint64_t guard_allocations = 0;
+/**
+ * @brief Mutex that protects the slot metadata.
+ */
+static pthread_mutex_t guard_lock = PTHREAD_MUTEX_INITIALIZER;
+/**
+ * @brief SIGSEGV disposition that was installed before the guard handler.
+ */
+static struct sigaction guard_previous_action;
+/**
+ * @brief Allocations left until the calling thread's next guarded one.
+ */
+static __thread unsigned long guard_countdown __attribute__((tls_model("initial-exec"))) = 0;
+/**
+ * @brief xorshift state of the calling thread's sampling intervals.
+ */
+static __thread uint64_t guard_random __attribute__((tls_model("initial-exec"))) = 0;
+
+/**
+ * @brief Cached kernel thread ID of the calling thread (0 until first use).
+ */
+static __thread pid_t cached_tid __attribute__((tls_model("initial-exec"))) = 0;
+/**
+ * @brief Depth of library calls into code that allocates through the interposers.
+ *
+ * Set around the original operator new, logging, stack capture,
+ * initialization and the exit reports. While it is non-zero the
+ * interposers pass calls straight to the original functions, so the
+ * library never recurses into its own tracking.
+ */
+static __thread int monitor_busy __attribute__((tls_model("initial-exec"))) = 0;
+/**
+ * @brief Set while the calling thread is in ensure_init(); its allocations are served from bootstrap_arena.
+ */
+static __thread int init_resolving __attribute__((tls_model("initial-exec"))) = 0;
+
+/**
+ * @brief Global variable tracking the total amount of memory allocated by malloc/calloc/realloc.
+ */
+static _Atomic size_t total_malloc_alloc = 0;
+
+/**
+ * @brief Open-addressing table of call sites (protected by alloc_lock).
+ */
+static Site sites[SITE_TABLE_SIZE];
+/**
+ * @brief Number of occupied slots in the sites table.
+ */
+static unsigned site_count = 0;
+/**
+ * @brief Site that collects all allocations once the sites table is 3/4 full.
+ */
+static Site overflow_site;
+
+/**
+ * @brief Live bytes mapped by mmap (never drops below zero on unmaps of untracked ranges).
+ */
+static _Atomic size_t live_mmap_bytes = 0;
+/**
+ * @brief Live malloc + mmap bytes.
+ */
+static _Atomic size_t live_total_bytes = 0;
+/**
+ * @brief Highest malloc total observed so far.
+ */
+static _Atomic size_t peak_malloc_bytes = 0;
+/**
+ * @brief Highest mmap total observed so far.
+ */
+static _Atomic size_t peak_mmap_bytes = 0;
+/**
+ * @brief Highest malloc + mmap total observed so far.
+ */
+static _Atomic size_t peak_total_alloc = 0;
+/**
+ * @brief Set when live_total_bytes reaches a new peak; the next decrease captures peak_snapshot.
+ */
+static atomic_int peak_pending = 0;
+
+/**
+ * @brief Number of largest live blocks kept in the top blocks heap.
+ */
+#define PEAK_TOP_BLOCKS 16
+/**
+ * @brief Number of largest live blocks kept in block_heap (a reserve above PEAK_TOP_BLOCKS).
+ */
+#define BLOCK_HEAP_SIZE 64
+/**
+ * @brief Number of sites with the most live bytes kept in the top sites heap.
+ */
+#define PEAK_TOP_SITES 8
+
+/**
+ * @struct PeakSnapshot
+ * @brief State of the process at the highest malloc + mmap total (protected by alloc_lock).
+ */
+typedef struct PeakSnapshot {
+    int captured;                               /**< Whether a peak was captured. */
+    size_t total_bytes;                         /**< malloc + mmap bytes at the peak. */
+    size_t missed_bytes;                        /**< Bytes released between the peak and the capture (0 if exact). */
+    size_t malloc_bytes;                        /**< malloc bytes at the peak. */
+    size_t mmap_bytes;                          /**< mmap bytes at the peak. */
+    uint64_t live_blocks;                       /**< Live malloc blocks at the peak. */
+    unsigned block_count;                       /**< Valid entries in blocks. */
+    Allocation blocks[PEAK_TOP_BLOCKS];         /**< Largest live blocks, largest first. */
+    unsigned site_count;                        /**< Valid entries in sites. */
+    Site sites[PEAK_TOP_SITES];                 /**< Sites with the most live bytes, largest first. */
+} PeakSnapshot;
+
+/**
+ * @struct BlockHeapNode
+ * @brief Entry of block_heap: the key is kept next to the slot pointer so sifting stays in the heap array.
+ */
+typedef struct BlockHeapNode {
+    size_t size;                /**< Size of the block (the heap key). */
+    Allocation *slot;           /**< Allocation table slot of the block. */
+} BlockHeapNode;
+
+/**
+ * @brief Min-heap (by size) of the largest live tracked blocks (protected by alloc_lock).
+ *
+ * The heap always holds exactly the block_heap_count largest live blocks:
+ * a new block enters only if it is larger than the smallest member (or
+ * every live block is a member), and the smallest member is evicted when
+ * the heap is full. Releasing a member keeps the invariant and only
+ * shrinks the heap, so malloc and free pay O(log BLOCK_HEAP_SIZE) at most.
+ * Each table slot stores its position in heap_index. Once fewer than
+ * PEAK_TOP_BLOCKS members are left, the next peak capture refills the
+ * heap from the allocation table.
+ */
+static BlockHeapNode block_heap[BLOCK_HEAP_SIZE];
+/**
+ * @brief Number of entries in block_heap.
+ */
+static size_t block_heap_count = 0;
+/**
+ * @brief Max-heap (by live bytes) of the sites with live blocks (protected by alloc_lock).
+ */
+static Site *site_heap[SITE_TABLE_SIZE + 1];
+/**
+ * @brief Number of entries in site_heap.
+ */
+static unsigned site_heap_count = 0;
+/**
+ * @brief State captured at the most recent peak.
+ */
+static PeakSnapshot peak_snapshot;
+
+/**
+ * @brief Number of tracked allocations made by malloc/calloc/realloc.
+ */
+static uint64_t malloc_calls = 0;
+/**
+ * @brief Number of realloc calls that resized an existing block.
+ */
+static uint64_t realloc_calls = 0;
+/**
+ * @brief Number of tracked deallocations of malloc/calloc/realloc blocks.
+ */
+static uint64_t free_calls = 0;
+/**
+ * @brief Number of successful mmap/mmap64 calls.
+ */
+static _Atomic uint64_t mmap_calls = 0;
+/**
+ * @brief Number of successful munmap/munmap64 calls.
+ */
+static _Atomic uint64_t munmap_calls = 0;
+/**
+ * @brief Number of live blocks in the allocation table.
+ */
+static uint64_t live_blocks = 0;
+/**
+ * @brief Live malloc blocks per size bucket (see size_bucket()).
+ */
+static uint64_t size_histogram[MM_HIST_BUCKETS];
+
+/**
+ * @struct MemoryStats
+ * @brief Consistent copy of the aggregated counters, taken under alloc_lock.
+ */
+typedef struct MemoryStats {
+    size_t malloc_bytes;                    /**< Live bytes from malloc/calloc/realloc. */
+    size_t mmap_bytes;                      /**< Live bytes from mmap. */
+    size_t peak_bytes;                      /**< Highest malloc + mmap total. */
+    size_t peak_malloc_bytes;               /**< Highest malloc total. */
+    size_t peak_mmap_bytes;                 /**< Highest mmap total. */
+    uint64_t malloc_calls;                  /**< Tracked allocations. */
+    uint64_t realloc_calls;                 /**< Reallocs of existing blocks. */
+    uint64_t free_calls;                    /**< Tracked deallocations. */
+    uint64_t mmap_calls;                    /**< Successful mmap calls. */
+    uint64_t munmap_calls;                  /**< Successful munmap calls. */
+    uint64_t live_blocks;                   /**< Live malloc blocks. */
+    uint64_t double_frees;                  /**< Detected double frees. */
+    uint64_t invalid_frees;                 /**< Detected frees of untracked pointers. */
+    uint64_t pending_frees;                 /**< Deferred frees not yet reconciled (still counted as live). */
+    uint64_t histogram[MM_HIST_BUCKETS];    /**< Live malloc blocks per size bucket. */
+} MemoryStats;
+
+/**
+ * @brief Whether every intercepted call is logged (MEMORY_MONITOR_LOG, default 1).
+ */
+static int log_operations = 1;
+
+/**
+ * @brief Mapped snapshot ring file, or NULL when MEMORY_MONITOR_RING is not set.
+ */
+static MMRingHeader *ring = NULL;
+/**
+ * @brief Size of the ring file mapping in bytes.
+ */
+static size_t ring_map_size = 0;
+/**
+ * @brief Open descriptor of the ring file, holding its exclusive lock.
+ */
+static int ring_fd = -1;
+/**
+ * @brief Process that created the ring mapping.
+ */
+static pid_t ring_pid = 0;
+/**
+ * @brief Snapshot cadence in milliseconds (MEMORY_MONITOR_RING_INTERVAL_MS).
+ */
+static long ring_interval_ms = 1000;
+/**
+ * @brief Background thread that appends records to the ring file.
+ */
+static pthread_t ring_thread;
+/**
+ * @brief Set by fini_library() to stop the ring thread.
+ */
+static int ring_stop = 0;
+/**
+ * @brief Mutex paired with ring_cond.
+ */
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+/**
+ * @brief Condition used to wake the ring thread early on shutdown.
+ */
+static pthread_cond_t ring_cond = PTHREAD_COND_INITIALIZER;
+
+#ifndef MPOL_F_MEMS_ALLOWED
+/**
+ * @brief get_mempolicy() flag returning the nodes the process may allocate from (linux/mempolicy.h).
+ */
+#define MPOL_F_MEMS_ALLOWED (1 << 2)
+#endif
+
+#ifndef MREMAP_DONTUNMAP
+/**
+ * @brief mremap() flag keeping the old mapping in place (linux/mman.h, Linux 5.7).
+ */
+#define MREMAP_DONTUNMAP 4
+#endif
+
+/**
+ * @brief Number of NUMA nodes counted separately; pages on higher nodes are counted in the last one.
+ */
+#define NUMA_MAX_NODES 16
+/**
+ * @brief Maximum number of large blocks and mappings whose placement is sampled.
+ */
+#define NUMA_REGIONS 256
+/**
+ * @brief Pages sampled per region and pass; larger regions are sampled with a stride.
+ */
+#define NUMA_SAMPLES_PER_REGION 256
+/**
+ * @brief Pages queried by a single move_pages() call.
+ */
+#define NUMA_QUERY_CHUNK 64
+/**
+ * @brief Number of regions listed in the NUMA report.
+ */
+#define NUMA_REPORT_REGIONS 10
+
+/**
+ * @brief Kinds of sampled regions.
+ */
+enum { NUMA_KIND_MALLOC, NUMA_KIND_MMAP };
+
+/**
+ * @struct NumaRegion
+ * @brief A large block or mapping whose page placement is sampled (protected by numa_lock).
+ *
+ * A pass samples up to NUMA_SAMPLES_PER_REGION evenly spaced pages and
+ * may span several ticks; its counts are published when it completes.
+ */
+typedef struct NumaRegion {
+    uint64_t id;                                /**< Unique region ID (0 marks an empty slot). */
+    uintptr_t start;                            /**< Start of the region. */
+    size_t length;                              /**< Length of the region in bytes. */
+    int kind;                                   /**< NUMA_KIND_MALLOC or NUMA_KIND_MMAP. */
+    pid_t tid;                                  /**< Thread that allocated the region. */
+    int cpu_node;                               /**< Node of the CPU the thread ran on when allocating. */
+    uint64_t generation;                        /**< Bumped whenever the region is trimmed. */
+    size_t cursor;                              /**< Next sample of the current pass. */
+    uint64_t pass_pages[NUMA_MAX_NODES];        /**< Sampled pages per node in the current pass. */
+    uint64_t pass_absent;                       /**< Sampled pages not yet faulted in, in the current pass. */
+    int sampled;                                /**< Whether a pass has completed. */
+    size_t stride;                              /**< Pages represented by one sample in the last pass. */
+    uint64_t pages[NUMA_MAX_NODES];             /**< Sampled pages per node in the last completed pass. */
+    uint64_t absent;                            /**< Sampled pages not present in the last completed pass. */
+} NumaRegion;
+
+/**
+ * @brief Whether page placement is sampled (MEMORY_MONITOR_NUMA=1).
+ */
+static int numa_enabled = 0;
+/**
+ * @brief Smallest block or mapping whose placement is sampled (MEMORY_MONITOR_NUMA_MIN_BYTES).
+ */
+static size_t numa_min_bytes = 1 << 20;
+/**
+ * @brief Pages queried per tick (MEMORY_MONITOR_NUMA_PAGES).
+ */
+static size_t numa_budget = 1024;
+/**
+ * @brief Sampling cadence in milliseconds (MEMORY_MONITOR_NUMA_INTERVAL_MS).
+ */
+static long numa_interval_ms = 1000;
+/**
+ * @brief Number of memory nodes the process may allocate from.
+ */
+static int numa_nodes = 1;
+/**
+ * @brief Sampled regions.
+ */
+static NumaRegion numa_regions[NUMA_REGIONS];
+/**
+ * @brief Last ID handed to a region.
+ */
+static uint64_t numa_last_id = 0;
+/**
+ * @brief Region slot where the next tick resumes.
+ */
+static unsigned numa_cursor = 0;
+/**
+ * @brief Large regions that were not sampled because the region table was full.
+ */
+static uint64_t numa_dropped = 0;
+/**
+ * @brief Mutex that protects the region table. Taken after alloc_lock when both are needed.
+ */
+static pthread_mutex_t numa_lock = PTHREAD_MUTEX_INITIALIZER;
+/**
+ * @brief Background thread that samples page placement.
+ */
+static pthread_t numa_thread;
+/**
+ * @brief Process that started the sampling thread (forked children do not have it).
+ */
+static pid_t numa_pid = 0;
+/**
+ * @brief Set by fini_library() to stop the sampling thread.
+ */
+static int numa_stop = 0;
+/**
+ * @brief Mutex paired with numa_cond.
+ */
+static pthread_mutex_t numa_wait_lock = PTHREAD_MUTEX_INITIALIZER;
+/**
+ * @brief Condition used to wake the sampling thread early on shutdown.
+ */
+static pthread_cond_t numa_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief Maximum number of metrics clients served concurrently.
+ */
+#define METRICS_MAX_CONNECTIONS 16
+/**
+ * @brief Size of the per-connection metrics response buffer.
+ */
+#define METRICS_RESPONSE_SIZE 16384
+/**
+ * @brief Number of call sites exported by the metrics endpoint.
+ */
+#define METRICS_TOP_SITES 10
+
+/**
+ * @struct MetricsConnection
+ * @brief State of a single client of the metrics socket.
+ *
+ * Buffers are static so the metrics thread never calls the interposed allocators.
+ */
+typedef struct MetricsConnection {
+    int fd;                                 /**< Client socket, or -1 when the slot is free. */
+    size_t request_length;                  /**< Bytes received in request. */
+    size_t length;                          /**< Length of the rendered response. */
+    size_t sent;                            /**< Bytes of the response already sent. */
+    char request[256];                      /**< Beginning of the client request. */
+    char response[METRICS_RESPONSE_SIZE];   /**< Rendered response. */
+} MetricsConnection;
+
+/**
+ * @brief Client slots of the metrics socket (used only by the metrics thread).
+ */
+static MetricsConnection metrics_connections[METRICS_MAX_CONNECTIONS];
+/**
+ * @brief Copy of the sites table taken by the metrics thread (used only by the metrics thread).
+ */
+static Site metrics_sites[SITE_TABLE_SIZE];
+/**
+ * @brief Listening Unix domain socket, or -1 when MEMORY_MONITOR_METRICS_SOCKET is not set.
+ */
+static int metrics_fd = -1;
+/**
+ * @brief epoll instance of the metrics thread.
+ */
+static int metrics_epoll_fd = -1;
+/**
+ * @brief eventfd used by fini_library() to stop the metrics thread.
+ */
+static int metrics_wake_fd = -1;
+/**
+ * @brief Process that owns the metrics socket.
+ */
+static pid_t metrics_pid = 0;
+/**
+ * @brief Filesystem path of the metrics socket.
+ */
+static char metrics_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+/**
+ * @brief Background thread serving the metrics socket.
+ */
+static pthread_t metrics_thread;
+
+/**
+ * @brief Thread-safe logging function to stderr.
+ *
+ * Logs events in the library (allocations, deallocations, etc.) in a thread-safe manner.
+ *
+ * @param format Format string (printf-style).
+ * @param ... Additional arguments.
+ */
+static void safe_log(const char *format, ...) {
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    va_list args;
+
+    monitor_busy++;
+    pthread_mutex_lock(&lock);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    pthread_mutex_unlock(&lock);
+    monitor_busy--;
+}
+
+/**
+ * @brief Logs an intercepted operation followed by the current usage.
+ *
+ * Does nothing when per-operation logging was disabled with MEMORY_MONITOR_LOG=0.
+ *
+ * @param format Format string (printf-style).
+ * @param ... Additional arguments.
+ */
+static void op_log(const char *format, ...) {
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    va_list args;
+
+    if (!log_operations) return;
+    monitor_busy++;
+    pthread_mutex_lock(&lock);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    pthread_mutex_unlock(&lock);
+    monitor_busy--;
+    printUsage();
+}
+
+/**
+ * @brief Maps an allocation size to its histogram bucket.
+ *
+ * @param size The size of the memory block in bytes.
+ * @return Bucket index in the range [0, MM_HIST_BUCKETS).
+ */
+static unsigned size_bucket(size_t size) {
+    if (size <= 16) return 0;
+    unsigned bucket = (unsigned)(sizeof(unsigned long long) * 8 - __builtin_clzll((unsigned long long)size - 1)) - 4;
+    return bucket < MM_HIST_BUCKETS ? bucket : MM_HIST_BUCKETS - 1;
+}
+
+/**
+ * @brief Raises a high-water mark to @p value with a compare-and-swap loop.
+ *
+ * @param peak The high-water mark.
+ * @param value The current value.
+ * @return 1 if @p value is a new peak.
+ */
+static inline int raise_peak(_Atomic size_t *peak, size_t value) {
+    size_t seen = atomic_load_explicit(peak, memory_order_relaxed);
+    while (value > seen) {
+        if (atomic_compare_exchange_weak_explicit(peak, &seen, value, memory_order_relaxed, memory_order_relaxed)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Counts the deferred frees buffered in all threads' batches without reconciling them.
+ *
+ * Each batch lock is held only to read its count, and alloc_lock is not
+ * taken at all.
+ *
+ * @return Number of buffered frees.
+ */
+static uint64_t count_pending_frees() {
+    uint64_t pending = 0;
+    if (!defer_frees) return 0;
+    pthread_mutex_lock(&free_batches_lock);
+    for (FreeBatch *batch = free_batches; batch; batch = batch->next) {
+        pthread_mutex_lock(&batch->lock);
+        pending += batch->count;
+        pthread_mutex_unlock(&batch->lock);
+    }
+    pthread_mutex_unlock(&free_batches_lock);
+    return pending;
+}
+
+/**
+ * @brief Copies all aggregated counters while holding alloc_lock.
+ *
+ * The counters are read as they stand: deferred frees of other threads
+ * are not reconciled here (the metrics thread calls this on every
+ * scrape), they are only counted in pending_frees. Callers that need
+ * exact counters flush the batches first.
+ *
+ * @param stats Destination of the copy.
+ */
+static void collect_stats(MemoryStats *stats) {
+    stats->pending_frees = count_pending_frees();
+    pthread_mutex_lock(&alloc_lock);
+    stats->malloc_bytes = total_malloc_alloc;
+    stats->mmap_bytes = total_mmap_alloc - total_mmap_dealloc;
+    stats->peak_bytes = peak_total_alloc;
+    stats->peak_malloc_bytes = peak_malloc_bytes;
+    stats->peak_mmap_bytes = peak_mmap_bytes;
+    stats->malloc_calls = malloc_calls;
+    stats->realloc_calls = realloc_calls;
+    stats->free_calls = free_calls;
+    stats->mmap_calls = mmap_calls;
+    stats->munmap_calls = munmap_calls;
+    stats->live_blocks = live_blocks;
+    stats->double_frees = double_frees;
+    stats->invalid_frees = invalid_frees;
+    memcpy(stats->histogram, size_histogram, sizeof(size_histogram));
+    pthread_mutex_unlock(&alloc_lock);
+}
+
+/**
+ * @brief Hashes a pointer into a table index.
+ *
+ * @param ptr The pointer to hash.
+ * @param bits Number of index bits (table size is 2^bits).
+ * @return Index in the range [0, 2^bits).
+ */
+static inline size_t hash_pointer(const void *ptr, unsigned bits) {
+    return (size_t)((((uintptr_t)ptr >> 4) * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+/**
+ * @brief Finds or inserts the statistics entry for a call site.
+ *
+ * Must be called with alloc_lock held. Once the table is 3/4 full, new
+ * sites are accounted to overflow_site.
+ *
+ * @param addr Return address of the allocating call.
+ * @return The site entry, never NULL.
+ */
+static Site *site_lookup(void *addr) {
+    size_t mask = SITE_TABLE_SIZE - 1;
+    size_t index = hash_pointer(addr, __builtin_ctz(SITE_TABLE_SIZE));
+    if (!addr) return &overflow_site;
+    while (sites[index].addr) {
+        if (sites[index].addr == addr) return &sites[index];
+        index = (index + 1) & mask;
+    }
+    if (site_count >= SITE_TABLE_SIZE / 4 * 3) return &overflow_site;
+    site_count++;
+    sites[index].addr = addr;
+    return &sites[index];
+}
+
+/**
+ * @brief Formats a call site as symbol+offset (or module+offset) using dladdr().
+ *
+ * @param addr The call site address.
+ * @param buffer Destination buffer.
+ * @param size Size of the destination buffer.
+ * @return @p buffer.
+ */
+static const char *describe_site(void *addr, char *buffer, size_t size) {
+    Dl_info info;
+    if (addr && dladdr(addr, &info)) {
+        if (info.dli_sname) {
+            snprintf(buffer, size, "%s+0x%lx", info.dli_sname, (unsigned long)((char *)addr - (char *)info.dli_saddr));
+        } else {
+            const char *module = info.dli_fname ? strrchr(info.dli_fname, '/') : NULL;
+            snprintf(buffer, size, "%s+0x%lx", module ? module + 1 : (info.dli_fname ? info.dli_fname : "?"),
+                     (unsigned long)((char *)addr - (char *)info.dli_fbase));
+        }
+    } else {
+        snprintf(buffer, size, "%s", addr ? "?" : "other");
+    }
+    return buffer;
+}
+
+/**
+ * @brief Hashes a call site by its module file name and offset, which do not change between runs.
+ *
+ * @param module Module file name without directories.
+ * @param offset Offset of the call site from the module base.
+ * @return The site hash (64-bit FNV-1a).
+ */
+static uint64_t site_hash(const char *module, uintptr_t offset) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char *c = module; *c; c++) {
+        hash = (hash ^ (unsigned char)*c) * 0x100000001b3ULL;
+    }
+    for (unsigned i = 0; i < sizeof(offset); i++) {
+        hash = (hash ^ ((offset >> (8 * i)) & 0xff)) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Resolves the module and hash of a call site using dladdr().
+ *
+ * @param addr The call site address.
+ * @param module Receives the module file name without directories ("" if unknown).
+ * @return The site hash, or 0 if the address is not in a loaded module.
+ */
+static uint64_t site_identity(void *addr, const char **module) {
+    Dl_info info;
+    *module = "";
+    if (!addr || !dladdr(addr, &info) || !info.dli_fname) return 0;
+    const char *slash = strrchr(info.dli_fname, '/');
+    *module = slash ? slash + 1 : info.dli_fname;
+    return site_hash(*module, (uintptr_t)addr - (uintptr_t)info.dli_fbase);
+}
+
+/**
+ * @brief Parses a comma-separated list of module names or hexadecimal site hashes.
+ *
+ * @param name Name of the environment variable.
+ * @param list Destination list.
+ * @param hashes Whether the entries are site hashes.
+ * @return Number of parsed entries.
+ */
+static unsigned filter_list_parse(const char *name, FilterList *list, int hashes) {
+    const char *value = getenv(name);
+    list->count = 0;
+    while (value && *value && list->count < FILTER_LIST_MAX) {
+        size_t length = strcspn(value, ",");
+        if (length > 0 && hashes) {
+            list->hashes[list->count++] = strtoull(value, NULL, 16);
+        } else if (length > 0 && length < FILTER_NAME_MAX) {
+            memcpy(list->modules[list->count], value, length);
+            list->modules[list->count++][length] = '\0';
+        }
+        value += length;
+        if (*value == ',') value++;
+    }
+    return list->count;
+}
+
+/**
+ * @brief Checks whether a module name or site hash is on a filter list.
+ *
+ * @param list The list.
+ * @param module Module file name (module lists).
+ * @param hash Site hash (site lists).
+ * @param hashes Whether @p list holds site hashes.
+ * @return 1 if the entry is on the list.
+ */
+static int filter_list_has(const FilterList *list, const char *module, uint64_t hash, int hashes) {
+    for (unsigned i = 0; i < list->count; i++) {
+        if (hashes ? list->hashes[i] == hash : strcmp(list->modules[i], module) == 0) return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Evaluates the module and site lists for a call site (uncached, calls dladdr).
+ *
+ * @param caller Return address of the allocating call.
+ * @return 1 if allocations from @p caller are tracked.
+ */
+static int filter_site_decision(void *caller) {
+    const char *module;
+    uint64_t hash = site_identity(caller, &module);
+    if (filter_modules.count && !filter_list_has(&filter_modules, module, 0, 0)) return 0;
+    if (filter_list_has(&filter_exclude_modules, module, 0, 0)) return 0;
+    if (filter_sites.count && !filter_list_has(&filter_sites, NULL, hash, 1)) return 0;
+    if (filter_list_has(&filter_exclude_sites, NULL, hash, 1)) return 0;
+    return 1;
+}
+
+/**
+ * @brief Returns the module and site decision for a call site, resolving it once per return address.
+ *
+ * The decision cache is read without a lock; an entry packs the address
+ * and the decision into one word, so it is published with a single
+ * compare-and-swap. Calls made while dladdr runs on the same thread are
+ * tracked and not cached.
+ *
+ * @param caller Return address of the allocating call.
+ * @return 1 if allocations from @p caller are tracked.
+ */
+static int filter_site_tracks(void *caller) {
+    static __thread int resolving __attribute__((tls_model("initial-exec")));
+    uintptr_t key = (uintptr_t)caller & ~FILTER_TRACKED;
+    size_t mask = ((size_t)1 << FILTER_CACHE_BITS) - 1;
+    size_t index = hash_pointer(caller, FILTER_CACHE_BITS);
+    for (unsigned probe = 0; probe < FILTER_CACHE_PROBES; probe++) {
+        uintptr_t entry = atomic_load_explicit(&filter_cache[(index + probe) & mask], memory_order_relaxed);
+        if (!entry) break;
+        if ((entry & ~FILTER_TRACKED) == key) return (entry & FILTER_TRACKED) != 0;
+    }
+    if (resolving) return 1;
+
+    resolving = 1;
+    int tracks = filter_site_decision(caller);
+    resolving = 0;
+    uintptr_t entry = key | (tracks ? FILTER_TRACKED : 0);
+    for (unsigned probe = 0; key && probe < FILTER_CACHE_PROBES; probe++) {
+        uintptr_t expected = 0;
+        if (atomic_compare_exchange_strong_explicit(&filter_cache[(index + probe) & mask], &expected, entry,
+                                                    memory_order_relaxed, memory_order_relaxed) ||
+            (expected & ~FILTER_TRACKED) == key) {
+            break;
+        }
+    }
+    return tracks;
+}
+
+/**
+ * @brief Decides on the hot path whether an allocation is tracked.
+ *
+ * Without filters this is a single branch; size limits are checked before
+ * the (cached) call site decision.
+ *
+ * @param size Requested allocation size.
+ * @param caller Return address of the allocating call.
+ * @return 1 if the allocation must be passed to add_allocation.
+ */
+static inline int filter_tracks(size_t size, void *caller) {
+    if (!filters_enabled) return 1;
+    if (size >= filter_min_size && size <= filter_max_size && (!filter_by_site || filter_site_tracks(caller))) return 1;
+    atomic_fetch_add_explicit(&filtered_allocations, 1, memory_order_relaxed);
+    return 0;
+}
+
+/**
+ * @brief Forgets the cached call site decisions (a module may be unloaded and another loaded at its address).
+ */
+static void filter_cache_clear() {
+    if (!filter_by_site) return;
+    for (size_t i = 0; i < ((size_t)1 << FILTER_CACHE_BITS); i++) {
+        atomic_store_explicit(&filter_cache[i], 0, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Reads the MEMORY_MONITOR_FILTER_* variables.
+ */
+static void filter_start() {
+    filter_min_size = env_number("MEMORY_MONITOR_FILTER_MIN_SIZE", 0);
+    filter_max_size = env_number("MEMORY_MONITOR_FILTER_MAX_SIZE", SIZE_MAX);
+    filter_by_site = filter_list_parse("MEMORY_MONITOR_FILTER_MODULES", &filter_modules, 0) |
+                     filter_list_parse("MEMORY_MONITOR_FILTER_EXCLUDE_MODULES", &filter_exclude_modules, 0) |
+                     filter_list_parse("MEMORY_MONITOR_FILTER_SITES", &filter_sites, 1) |
+                     filter_list_parse("MEMORY_MONITOR_FILTER_EXCLUDE_SITES", &filter_exclude_sites, 1);
+    filter_by_site = filter_by_site != 0;
+    filters_enabled = filter_min_size > 0 || filter_max_size < SIZE_MAX || filter_by_site;
+    if (filters_enabled) {
+        char max_size[32] = "unlimited";
+        if (filter_max_size < SIZE_MAX) snprintf(max_size, sizeof(max_size), "%zu", filter_max_size);
+        safe_log("[filter] tracking sizes %zu..%s with %u module and %u site filters; untracked frees are not reported\n",
+                 filter_min_size, max_size, filter_modules.count + filter_exclude_modules.count,
+                 filter_sites.count + filter_exclude_sites.count);
+    }
+}
+
+/**
+ * @brief Returns the kernel thread ID of the calling thread.
+ *
+ * The ID is cached in TLS, so only the first call of a thread is a syscall.
+ *
+ * @return The thread ID.
+ */
+static inline pid_t current_tid() {
+    if (!cached_tid) {
+        cached_tid = (pid_t)syscall(SYS_gettid);
+    }
+    return cached_tid;
+}
+
+/**
+ * @brief Returns the current CLOCK_MONOTONIC time in nanoseconds.
+ *
+ * @return Monotonic time in nanoseconds.
+ */
+static uint64_t monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Closes the perf_event counters of a thread.
+ *
+ * @param thread The thread's overhead state.
+ */
+static void overhead_close(OverheadThread *thread) {
+    for (int i = 0; i < OVERHEAD_COUNTERS; i++) {
+        if (thread->pages[i]) real_munmap(thread->pages[i], (size_t)getpagesize());
+        if (thread->fds[i] > 0) close(thread->fds[i]);
+        thread->pages[i] = NULL;
+        thread->fds[i] = 0;
+    }
+}
+
+/**
+ * @brief Opens user-space cycle, instruction and cache-miss counters of the calling thread.
+ *
+ * Each counter's control page is mapped so it can be read with rdpmc
+ * without a syscall. Fails if any counter cannot be opened or the kernel
+ * does not allow rdpmc.
+ *
+ * @param thread The calling thread's overhead state.
+ * @return 0 on success, -1 with errno set otherwise.
+ */
+static int overhead_open(OverheadThread *thread) {
+#if defined(__x86_64__) || defined(__i386__)
+    static const uint64_t configs[OVERHEAD_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+    };
+    for (int i = 0; i < OVERHEAD_COUNTERS; i++) {
+        struct perf_event_attr attr = {
+            .type = PERF_TYPE_HARDWARE, .size = sizeof(attr), .config = configs[i],
+            .exclude_kernel = 1, .exclude_hv = 1
+        };
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        if (fd < 0) {
+            overhead_close(thread);
+            return -1;
+        }
+        thread->fds[i] = fd;
+        void *page = real_mmap(NULL, (size_t)getpagesize(), PROT_READ, MAP_SHARED, fd, 0);
+        if (page == MAP_FAILED) {
+            overhead_close(thread);
+            return -1;
+        }
+        thread->pages[i] = page;
+        if (!thread->pages[i]->cap_user_rdpmc) {
+            overhead_close(thread);
+            errno = EPERM;
+            return -1;
+        }
+    }
+    return 0;
+#else
+    (void)thread;
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+/**
+ * @brief Reads a counter with rdpmc using the control page's seqlock protocol.
+ *
+ * When the counter is not scheduled on the CPU (index 0), the value is
+ * read with a syscall instead.
+ *
+ * @param page The counter's control page.
+ * @param fd The counter's file descriptor.
+ * @return The counter value.
+ */
+static inline uint64_t overhead_read_counter(struct perf_event_mmap_page *page, int fd) {
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t count;
+    uint32_t seq, index;
+    do {
+        seq = page->lock;
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        index = page->index;
+        count = page->offset;
+        if (index) {
+            uint64_t pmc = __builtin_ia32_rdpmc(index - 1);
+            unsigned shift = 64 - page->pmc_width;
+            count += (uint64_t)((int64_t)(pmc << shift) >> shift);
+        }
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    } while (page->lock != seq);
+    if (!index && read(fd, &count, sizeof(count)) != (ssize_t)sizeof(count)) count = 0;
+    return count;
+#else
+    (void)page;
+    (void)fd;
+    return 0;
+#endif
+}
+
+/**
+ * @brief Samples the calling thread's counters (or the clock in the fallback mode).
+ *
+ * @param thread The calling thread's overhead state.
+ * @param values Receives OVERHEAD_COUNTERS values.
+ */
+static inline void overhead_sample(OverheadThread *thread, uint64_t *values) {
+    if (overhead_mode == MM_OVERHEAD_CYCLES) {
+        for (int i = 0; i < OVERHEAD_COUNTERS; i++) {
+            values[i] = overhead_read_counter(thread->pages[i], thread->fds[i]);
+        }
+    } else {
+        values[0] = monotonic_ns();
+        values[1] = values[2] = 0;
+    }
+}
+
+/**
+ * @brief Prepares the calling thread's counters on its first measured call.
+ *
+ * @param thread The calling thread's overhead state.
+ */
+static void overhead_thread_start(OverheadThread *thread) {
+    thread->state = OVERHEAD_DISABLED;
+    if (overhead_mode == MM_OVERHEAD_CYCLES && overhead_open(thread) == -1) {
+        pthread_mutex_lock(&overhead_lock);
+        overhead_unmeasured++;
+        pthread_mutex_unlock(&overhead_lock);
+        return;
+    }
+    if (!thread->registered) {
+        pthread_mutex_lock(&overhead_lock);
+        thread->next = overhead_threads;
+        overhead_threads = thread;
+        thread->registered = 1;
+        pthread_mutex_unlock(&overhead_lock);
+        pthread_setspecific(overhead_key, thread);
+    }
+    thread->depth = 0;
+    thread->state = OVERHEAD_ACTIVE;
+}
+
+/**
+ * @brief Starts measuring an intercepted call.
+ *
+ * Nested interposer calls (e.g. from backtrace) are part of the outer call.
+ */
+static inline void overhead_enter() {
+    if (!overhead_mode) return;
+    OverheadThread *thread = &overhead_thread;
+    if (thread->state == OVERHEAD_UNSET) overhead_thread_start(thread);
+    if (thread->state != OVERHEAD_ACTIVE || thread->depth++) return;
+    memset(thread->self, 0, sizeof(thread->self));
+    memset(thread->real, 0, sizeof(thread->real));
+    overhead_sample(thread, thread->mark);
+}
+
+/**
+ * @brief Ends a library segment of the measured call before a real_* function is called.
+ */
+static inline void overhead_real_begin() {
+    if (!overhead_mode) return;
+    OverheadThread *thread = &overhead_thread;
+    if (thread->state != OVERHEAD_ACTIVE || thread->depth != 1) return;
+    uint64_t now[OVERHEAD_COUNTERS];
+    overhead_sample(thread, now);
+    for (int i = 0; i < OVERHEAD_COUNTERS; i++) {
+        thread->self[i] += now[i] - thread->mark[i];
+        thread->mark[i] = now[i];
+    }
+}
+
+/**
+ * @brief Ends a real_* segment of the measured call.
+ */
+static inline void overhead_real_end() {
+    if (!overhead_mode) return;
+    OverheadThread *thread = &overhead_thread;
+    if (thread->state != OVERHEAD_ACTIVE || thread->depth != 1) return;
+    uint64_t now[OVERHEAD_COUNTERS];
+    overhead_sample(thread, now);
+    for (int i = 0; i < OVERHEAD_COUNTERS; i++) {
+        thread->real[i] += now[i] - thread->mark[i];
+        thread->mark[i] = now[i];
+    }
+}
+
+/**
+ * @brief Finishes measuring an intercepted call and adds it to the thread's totals.
+ *
+ * @param op The operation type (MM_OP_*).
+ */
+static inline void overhead_leave(int op) {
+    if (!overhead_mode) return;
+    OverheadThread *thread = &overhead_thread;
+    if (thread->state != OVERHEAD_ACTIVE || thread->depth == 0 || --thread->depth) return;
+    uint64_t now[OVERHEAD_COUNTERS];
+    overhead_sample(thread, now);
+    for (int i = 0; i < OVERHEAD_COUNTERS; i++) {
+        uint64_t self = thread->self[i] + now[i] - thread->mark[i];
+        atomic_store_explicit(&thread->self_total[op][i],
+                              atomic_load_explicit(&thread->self_total[op][i], memory_order_relaxed) + self,
+                              memory_order_relaxed);
+        atomic_store_explicit(&thread->real_total[op][i],
+                              atomic_load_explicit(&thread->real_total[op][i], memory_order_relaxed) + thread->real[i],
+                              memory_order_relaxed);
+    }
+    atomic_store_explicit(&thread->calls[op],
+                          atomic_load_explicit(&thread->calls[op], memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+/**
+ * @brief Calls real_free as a real_* segment of the measured call.
+ *
+ * @param ptr Pointer to release.
+ */
+static inline void call_real_free(void *ptr) {
+    overhead_real_begin();
+    real_free(ptr);
+    overhead_real_end();
+}
+
+/**
+ * @brief Adds one thread's counters to a total.
+ *
+ * @param totals The total to update.
+ * @param thread The thread's overhead state.
+ */
+static void overhead_add(OverheadTotals *totals, OverheadThread *thread) {
+    for (int op = 0; op < MM_OVERHEAD_OPS; op++) {
+        totals->calls[op] += atomic_load_explicit(&thread->calls[op], memory_order_relaxed);
+        for (int i = 0; i < OVERHEAD_COUNTERS; i++) {
+            totals->self[op][i] += atomic_load_explicit(&thread->self_total[op][i], memory_order_relaxed);
+            totals->real[op][i] += atomic_load_explicit(&thread->real_total[op][i], memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * @brief Sums the overhead counters of all threads, including exited ones.
+ *
+ * @param totals Receives the sums.
+ */
+static void overhead_collect(OverheadTotals *totals) {
+    pthread_mutex_lock(&overhead_lock);
+    *totals = overhead_exited;
+    for (OverheadThread *thread = overhead_threads; thread; thread = thread->next) {
+        overhead_add(totals, thread);
+    }
+    pthread_mutex_unlock(&overhead_lock);
+}
+
+/**
+ * @brief Thread exit destructor: folds the thread's counters into overhead_exited and closes them.
+ *
+ * @param arg The exiting thread's OverheadThread.
+ */
+static void overhead_thread_exit(void *arg) {
+    OverheadThread *thread = arg;
+    pthread_mutex_lock(&overhead_lock);
+    for (OverheadThread **link = &overhead_threads; *link; link = &(*link)->next) {
+        if (*link == thread) {
+            *link = thread->next;
+            break;
+        }
+    }
+    overhead_add(&overhead_exited, thread);
+    thread->registered = 0;
+    pthread_mutex_unlock(&overhead_lock);
+    thread->state = OVERHEAD_DISABLED;
+    overhead_close(thread);
+}
+
+/**
+ * @brief fork() child handler: reopens the counters of the surviving thread.
+ *
+ * Inherited perf_event descriptors keep counting the parent's thread, so
+ * the child closes them and opens its own on the next call.
+ */
+static void overhead_after_fork() {
+    OverheadThread *thread = &overhead_thread;
+    pthread_mutex_init(&overhead_lock, NULL);
+    if (thread->state == OVERHEAD_ACTIVE) {
+        overhead_close(thread);
+        thread->state = OVERHEAD_UNSET;
+    }
+}
+
+/**
+ * @brief Prepares a recycled thread slot for a new thread. Must be called with alloc_lock held.
+ *
+ * The statistics and the slot's row and column of the free matrix belong
+ * to the previous thread and are cleared.
+ *
+ * @param index The recycled slot.
+ */
+static void thread_slot_clear(unsigned index) {
+    memset(&thread_stats[index], 0, sizeof(ThreadStats));
+    for (unsigned i = 0; i < THREAD_SLOTS; i++) {
+        atomic_store_explicit(&thread_frees[index][i], 0, memory_order_relaxed);
+        atomic_store_explicit(&thread_frees[i][index], 0, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Releases the slot of an exited thread once none of its blocks is live. Must be called with alloc_lock held.
+ *
+ * @param index The thread slot.
+ */
+static void thread_slot_release(unsigned index) {
+    ThreadStats *stats = &thread_stats[index];
+    if (index >= THREAD_SLOTS - 1 || !stats->exit_ns || stats->live_blocks || stats->released) return;
+    stats->released = 1;
+    thread_free_slots[thread_free_slot_count++] = index;
+}
+
+/**
+ * @brief Returns the thread slot of the calling thread, assigning one on first use.
+ *
+ * The slot is cached in TLS, so only the first call of a thread touches
+ * shared state. Slots released by exited threads are reused first. Must
+ * not be called with alloc_lock held.
+ *
+ * @return The thread slot index.
+ */
+static inline unsigned current_thread_slot() {
+    if (thread_slot) return thread_slot - 1;
+
+    uint64_t now = monotonic_ns();
+    pid_t tid = current_tid();
+    unsigned index;
+    pthread_mutex_lock(&alloc_lock);
+    threads_started++;
+    if (thread_free_slot_count) {
+        index = thread_free_slots[--thread_free_slot_count];
+        thread_slot_clear(index);
+    } else {
+        index = atomic_load_explicit(&thread_slots_used, memory_order_relaxed);
+        if (index < THREAD_SLOTS) atomic_store_explicit(&thread_slots_used, index + 1, memory_order_relaxed);
+        else index = THREAD_SLOTS - 1;
+    }
+    if (index < THREAD_SLOTS - 1) thread_stats[index].tid = tid;
+    if (!thread_stats[index].start_ns) thread_stats[index].start_ns = now;
+    pthread_mutex_unlock(&alloc_lock);
+    thread_slot = index + 1;
+    if (thread_exit_key_ready && index < THREAD_SLOTS - 1) {
+        pthread_setspecific(thread_exit_key, &thread_stats[index]);
+    }
+    return index;
+}
+
+/**
+ * @brief Records that a block allocated by @p producer was freed by @p consumer.
+ *
+ * @param consumer Thread slot of the freeing thread (the row being written).
+ * @param producer Thread slot that owned the block.
+ */
+static inline void count_thread_free(unsigned consumer, unsigned producer) {
+    atomic_fetch_add_explicit(&thread_frees[consumer][producer], 1, memory_order_relaxed);
+}
+
+/**
+ * @brief Thread exit destructor: records when the thread exited and releases its slot.
+ *
+ * The thread's deferred frees are reconciled first, so they are still
+ * counted in its own row. Anything the thread does afterwards (e.g. while
+ * glibc tears down its TLS) is counted in the shared slot. The slot is
+ * released now if none of the thread's blocks is live, otherwise by the
+ * free of its last block.
+ *
+ * @param arg The exiting thread's ThreadStats.
+ */
+static void thread_stats_exit(void *arg) {
+    ThreadStats *stats = arg;
+    uint64_t now = monotonic_ns();
+    free_batch_release_slot();
+    thread_slot = THREAD_SLOTS;
+    pthread_mutex_lock(&alloc_lock);
+    stats->exit_ns = now;
+    thread_slot_release((unsigned)(stats - thread_stats));
+    pthread_mutex_unlock(&alloc_lock);
+}
+
+/**
+ * @brief Selects the producer/consumer pairs with the most cross-thread frees.
+ *
+ * Only the first @p slots thread slots are scanned: the caller passes the
+ * number of ThreadStats it copied, so every pair refers to a copied entry
+ * even if a thread registered in the meantime.
+ *
+ * @param pairs Receives the pairs, most frees first.
+ * @param max Capacity of @p pairs.
+ * @param slots Number of thread slots to scan.
+ * @return Number of pairs stored.
+ */
+static unsigned top_thread_pairs(ThreadPair *pairs, unsigned max, unsigned slots) {
+    unsigned count = 0;
+
+    for (unsigned consumer = 0; consumer < slots; consumer++) {
+        for (unsigned producer = 0; producer < slots; producer++) {
+            uint64_t frees = atomic_load_explicit(&thread_frees[consumer][producer], memory_order_relaxed);
+            if (producer == consumer || frees == 0) continue;
+            unsigned pos = count < max ? count++ : max;
+            while (pos > 0 && pairs[pos - 1].frees < frees) {
+                if (pos < max) pairs[pos] = pairs[pos - 1];
+                pos--;
+            }
+            if (pos < max) pairs[pos] = (ThreadPair){ .producer = producer, .consumer = consumer, .frees = frees };
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Increments a saturating filter counter. Must be called with alloc_lock held.
+ *
+ * @param counter The counter selected by a pointer's hash.
+ */
+static inline void counter_increment(_Atomic unsigned char *counter) {
+    unsigned char value = atomic_load_explicit(counter, memory_order_relaxed);
+    if (value != UCHAR_MAX) {
+        atomic_store_explicit(counter, value + 1, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Decrements a filter counter unless it is zero or saturated. Must be called with alloc_lock held.
+ *
+ * @param counter The counter selected by a pointer's hash.
+ */
+static inline void counter_decrement(_Atomic unsigned char *counter) {
+    unsigned char value = atomic_load_explicit(counter, memory_order_relaxed);
+    if (value != UCHAR_MAX && value != 0) {
+        atomic_store_explicit(counter, value - 1, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Checks the membership filter without taking alloc_lock.
+ *
+ * @param ptr Pointer to check.
+ * @return 0 if @p ptr is certainly not tracked, 1 if it may be tracked.
+ */
+static inline int membership_maybe(const void *ptr) {
+    return atomic_load_explicit(&membership[hash_pointer(ptr, MEMBERSHIP_BITS)], memory_order_relaxed) != 0;
+}
+
+/**
+ * @brief Adds a pointer to the membership filter. Must be called with alloc_lock held.
+ *
+ * @param ptr The newly tracked pointer.
+ */
+static inline void membership_add(const void *ptr) {
+    counter_increment(&membership[hash_pointer(ptr, MEMBERSHIP_BITS)]);
+}
+
+/**
+ * @brief Removes a pointer from the membership filter. Must be called with alloc_lock held.
+ *
+ * @param ptr The pointer that is no longer tracked.
+ */
+static inline void membership_remove(const void *ptr) {
+    counter_decrement(&membership[hash_pointer(ptr, MEMBERSHIP_BITS)]);
+}
+
+/**
+ * @brief Checks the recently freed filter without taking alloc_lock.
+ *
+ * @param ptr Pointer to check.
+ * @return 0 if @p ptr is certainly not in freed_history, 1 if it may be.
+ */
+static inline int freed_maybe(const void *ptr) {
+    return atomic_load_explicit(&freed_filter[hash_pointer(ptr, FREED_FILTER_BITS)], memory_order_relaxed) != 0;
+}
+
+/**
+ * @brief Records the calling stack, starting at the program's call into the library.
+ *
+ * Frames before @p caller belong to the library and are dropped.
+ *
+ * @param stack Destination of the frames.
+ * @param max_depth Capacity of @p stack.
+ * @param caller Return address of the intercepted call.
+ * @return Number of frames stored.
+ */
+static int capture_stack(void **stack, int max_depth, void *caller) {
+    void *frames[max_depth + 4];
+    monitor_busy++;
+    int depth = backtrace(frames, max_depth + 4);
+    monitor_busy--;
+    int first = 0;
+    int count = 0;
+    while (first < depth && frames[first] != caller) first++;
+    if (first == depth) first = 0;
+    for (int i = first; i < depth && count < max_depth; i++) {
+        stack[count++] = frames[i];
+    }
+    return count;
+}
+
+/**
+ * @brief Captures the stack of a free call if MEMORY_MONITOR_FREE_STACKS=1.
+ *
+ * Must be called without alloc_lock: backtrace() can take the dynamic
+ * loader's locks and allocate, and a thread inside dlopen() may hold them
+ * while waiting for alloc_lock in malloc.
+ *
+ * @param stack Receives the frames.
+ * @param caller Return address of the free call.
+ */
+static inline void free_stack_capture(FreeStack *stack, void *caller) {
+    stack->depth = free_stacks ? capture_stack(stack->frames, FREE_STACK_DEPTH, caller) : 0;
+}
+
+/**
+ * @brief Remembers a free for later double-free reports. Must be called with alloc_lock held.
+ *
+ * @param ptr The freed pointer.
+ * @param caller Return address of the free call.
+ * @param stack Stack captured by free_stack_capture() before alloc_lock was taken.
+ */
+static void remember_free(void *ptr, void *caller, const FreeStack *stack) {
+    FreedBlock *block = &freed_history[freed_history_count++ % FREED_HISTORY_SIZE];
+    if (block->ptr) counter_decrement(&freed_filter[hash_pointer(block->ptr, FREED_FILTER_BITS)]);
+    counter_increment(&freed_filter[hash_pointer(ptr, FREED_FILTER_BITS)]);
+    block->ptr = ptr;
+    block->caller = caller;
+    block->tid = current_tid();
+    block->stack.depth = stack->depth;
+    memcpy(block->stack.frames, stack->frames, stack->depth * sizeof(void *));
+}
+
+/**
+ * @brief Removes every freed_history entry of a pointer. Must be called with alloc_lock held.
+ *
+ * @param ptr The pointer that is live again.
+ */
+static void freed_history_drop(void *ptr) {
+    uint64_t count = freed_history_count < FREED_HISTORY_SIZE ? freed_history_count : FREED_HISTORY_SIZE;
+    for (uint64_t i = 1; i <= count; i++) {
+        FreedBlock *block = &freed_history[(freed_history_count - i) % FREED_HISTORY_SIZE];
+        if (block->ptr == ptr) {
+            counter_decrement(&freed_filter[hash_pointer(ptr, FREED_FILTER_BITS)]);
+            block->ptr = NULL;
+        }
+    }
+}
+
+/**
+ * @brief Drops a pointer from freed_history because it was returned by an untracked allocation.
+ *
+ * While tracking filters are active, an address freed by a tracked block
+ * can be handed out again to an untracked one. Its later free must not be
+ * mistaken for a double free of the old block.
+ *
+ * @param ptr Pointer returned by an untracked allocation.
+ */
+static void forget_free(void *ptr) {
+    if (!freed_maybe(ptr)) return;
+    pthread_mutex_lock(&alloc_lock);
+    freed_history_drop(ptr);
+    pthread_mutex_unlock(&alloc_lock);
+}
+
+/**
+ * @brief Reports a free of a pointer that is not tracked.
+ *
+ * A pointer found among the recent frees is a double free; any other
+ * pointer was never returned by a tracked allocation (or was freed too
+ * long ago to tell). With MEMORY_MONITOR_BAD_FREE=abort the process is
+ * aborted after the report. While tracking filters are active, double
+ * frees of tracked blocks are still reported, but a pointer missing from
+ * the history is expected (the filter excluded it) and is passed on
+ * silently.
+ *
+ * @param ptr The pointer passed to free.
+ * @param caller Return address of the free call.
+ * @return 1 if the pointer must not be passed to real_free (double free), 0 otherwise.
+ */
+static int report_bad_free(void *ptr, void *caller) {
+    FreedBlock first = { .ptr = NULL };
+    char name[256], first_name[256];
+
+    if (filters_enabled && !freed_maybe(ptr)) return 0;
+    pthread_mutex_lock(&alloc_lock);
+    uint64_t count = freed_history_count < FREED_HISTORY_SIZE ? freed_history_count : FREED_HISTORY_SIZE;
+    for (uint64_t i = 1; i <= count; i++) {
+        FreedBlock *block = &freed_history[(freed_history_count - i) % FREED_HISTORY_SIZE];
+        if (block->ptr == ptr) {
+            first = *block;
+            break;
+        }
+    }
+    if (first.ptr) {
+        double_frees++;
+    } else if (!filters_enabled) {
+        invalid_frees++;
+    }
+    pthread_mutex_unlock(&alloc_lock);
+    if (!first.ptr && filters_enabled) return 0;
+
+    if (first.ptr) {
+        safe_log("[bad free] double free of %p by thread %d at %p (%s) | first freed by thread %d at %p (%s)\n",
+                 ptr, (int)current_tid(), caller, describe_site(caller, name, sizeof(name)),
+                 (int)first.tid, first.caller, describe_site(first.caller, first_name, sizeof(first_name)));
+        for (int i = 0; i < first.stack.depth; i++) {
+            safe_log("[bad free]   #%d %p (%s)\n", i, first.stack.frames[i],
+                     describe_site(first.stack.frames[i], name, sizeof(name)));
+        }
+    } else {
+        safe_log("[bad free] free of untracked pointer %p by thread %d at %p (%s)\n",
+                 ptr, (int)current_tid(), caller, describe_site(caller, name, sizeof(name)));
+    }
+    if (bad_free_abort) {
+        abort();
+    }
+    return first.ptr != NULL;
+}
+
+/**
+ * @brief Decides whether the calling thread's next allocation is served from the guarded pool.
+ *
+ * Intervals between guarded allocations are drawn uniformly from
+ * [1, 2 * guard_sample_rate - 1], so the common path is a TLS decrement.
+ *
+ * @param size Requested allocation size.
+ * @return 1 if the allocation should be guarded.
+ */
+static inline int guard_sample(size_t size) {
+    if (!guard_sample_rate || size > guard_page_size) return 0;
+    if (guard_countdown > 1) {
+        guard_countdown--;
+        return 0;
+    }
+    int sampled = guard_countdown == 1;
+    if (!guard_random) {
+        guard_random = ((uint64_t)current_tid() << 32) ^ (uint64_t)(uintptr_t)&guard_random ^ 0x9E3779B97F4A7C15ULL;
+    }
+    guard_random ^= guard_random << 13;
+    guard_random ^= guard_random >> 7;
+    guard_random ^= guard_random << 17;
+    guard_countdown = 1 + guard_random % (2 * guard_sample_rate - 1);
+    /* A thread's first allocation only starts its countdown. */
+    return sampled || guard_countdown == 1;
+}
+
+/**
+ * @brief Checks whether a pointer lies in the guarded pool.
+ *
+ * @param ptr The pointer to check.
+ * @return 1 if @p ptr belongs to the pool.
+ */
+static inline int guard_owns(const void *ptr) {
+    return (uintptr_t)ptr >= guard_pool_start && (uintptr_t)ptr < guard_pool_end;
+}
+
+/**
+ * @brief Serves an allocation from a free slot of the guarded pool.
+ *
+ * The block is placed at the end of the slot page so the guard page
+ * follows it directly. Its alignment is the largest power of two that
+ * divides the size (at most 16), which is all a block of that size can
+ * require, so even a one-byte overflow reaches the guard page.
+ *
+ * @param size Requested size (at most one page).
+ * @param caller Return address of the intercepted call.
+ * @return The block, or NULL if every slot is live.
+ */
+static void *guard_alloc(size_t size, void *caller) {
+    void *stack[GUARD_STACK_DEPTH];
+    int depth = capture_stack(stack, GUARD_STACK_DEPTH, caller);
+    size_t alignment = size & 15 ? size & -size : 16;
+    size_t rounded = size ? (size + alignment - 1) & ~(alignment - 1) : 16;
+
+    pthread_mutex_lock(&guard_lock);
+    GuardSlot *slot = NULL;
+    size_t index = 0;
+    for (size_t i = 0; i < guard_slot_count; i++) {
+        index = (guard_next_slot + i) % guard_slot_count;
+        if (guard_slots[index].state != GUARD_SLOT_LIVE) {
+            slot = &guard_slots[index];
+            break;
+        }
+    }
+    if (!slot) {
+        pthread_mutex_unlock(&guard_lock);
+        return NULL;
+    }
+    uintptr_t page = guard_pool_start + (2 * index + 1) * guard_page_size;
+    if (mprotect((void *)page, guard_page_size, PROT_READ | PROT_WRITE) == -1) {
+        pthread_mutex_unlock(&guard_lock);
+        return NULL;
+    }
+    guard_next_slot = (index + 1) % guard_slot_count;
+    slot->ptr = page + guard_page_size - rounded;
+    slot->size = size;
+    slot->state = GUARD_SLOT_LIVE;
+    slot->alloc_tid = current_tid();
+    slot->alloc_depth = depth;
+    memcpy(slot->alloc_stack, stack, sizeof(stack));
+    slot->free_depth = 0;
+    guard_allocations++;
+    pthread_mutex_unlock(&guard_lock);
+    return (void *)slot->ptr;
+}
+
+/**
+ * @brief Returns the requested size of a live guarded block.
+ *
+ * The slot records the size whether or not the tracking filters selected
+ * the block, so realloc can copy its contents either way.
+ *
+ * @param ptr Pointer inside the guarded pool.
+ * @return The size, or 0 if @p ptr is not the start of a live slot.
+ */
+static size_t guard_block_size(const void *ptr) {
+    size_t page_index = ((uintptr_t)ptr - guard_pool_start) / guard_page_size;
+    size_t size = 0;
+    if (page_index % 2 == 0) return 0;
+    pthread_mutex_lock(&guard_lock);
+    GuardSlot *slot = &guard_slots[page_index / 2];
+    if (slot->state == GUARD_SLOT_LIVE && slot->ptr == (uintptr_t)ptr) size = slot->size;
+    pthread_mutex_unlock(&guard_lock);
+    return size;
+}
+
+/**
+ * @brief Logs a stack recorded for a guarded slot.
+ *
+ * @param what "allocated" or "freed".
+ * @param tid Thread that performed the operation.
+ * @param stack Recorded frames.
+ * @param depth Number of frames.
+ */
+static void guard_log_stack(const char *what, pid_t tid, void *const *stack, int depth) {
+    char name[256];
+    safe_log("[guard]   %s by thread %d:\n", what, (int)tid);
+    for (int i = 0; i < depth; i++) {
+        safe_log("[guard]     #%d %p (%s)\n", i, stack[i], describe_site(stack[i], name, sizeof(name)));
+    }
+}
+
+/**
+ * @brief Returns a guarded block to the pool and quarantines its slot.
+ *
+ * The page is discarded (so it reads back as zeros when reused) and made
+ * PROT_NONE, turning any later access into a use-after-free fault. A
+ * pointer that is not the start of a live slot is reported as a double or
+ * invalid free and left alone.
+ *
+ * @param ptr Pointer inside the guarded pool.
+ * @param caller Return address of the free call.
+ * @return 0 if the block was released, -1 if the free was invalid.
+ */
+static int guard_release(void *ptr, void *caller) {
+    void *stack[GUARD_STACK_DEPTH];
+    int depth = capture_stack(stack, GUARD_STACK_DEPTH, caller);
+    size_t page_index = ((uintptr_t)ptr - guard_pool_start) / guard_page_size;
+    GuardSlot *slot = page_index % 2 ? &guard_slots[page_index / 2] : NULL;
+
+    pthread_mutex_lock(&guard_lock);
+    if (!slot || slot->state != GUARD_SLOT_LIVE || slot->ptr != (uintptr_t)ptr) {
+        GuardSlot copy = slot ? *slot : (GuardSlot){ .state = GUARD_SLOT_UNUSED };
+        pthread_mutex_unlock(&guard_lock);
+        if (copy.state == GUARD_SLOT_FREED && copy.ptr == (uintptr_t)ptr) {
+            safe_log("[guard] double free of %zu-byte block %p\n", copy.size, ptr);
+            guard_log_stack("allocated", copy.alloc_tid, copy.alloc_stack, copy.alloc_depth);
+            guard_log_stack("first freed", copy.free_tid, copy.free_stack, copy.free_depth);
+        } else {
+            safe_log("[guard] invalid free of %p inside the guarded pool\n", ptr);
+        }
+        guard_log_stack("freed", current_tid(), stack, depth);
+        if (bad_free_abort) abort();
+        return -1;
+    }
+    uintptr_t page = slot->ptr & ~(uintptr_t)(guard_page_size - 1);
+    madvise((void *)page, guard_page_size, MADV_DONTNEED);
+    mprotect((void *)page, guard_page_size, PROT_NONE);
+    slot->state = GUARD_SLOT_FREED;
+    slot->free_tid = current_tid();
+    slot->free_depth = depth;
+    memcpy(slot->free_stack, stack, sizeof(stack));
+    pthread_mutex_unlock(&guard_lock);
+    return 0;
+}
+
+/**
+ * @brief Writes a string to stderr from the signal handler.
+ *
+ * @param text The string to write.
+ */
+static void guard_write(const char *text) {
+    ssize_t ignored = write(STDERR_FILENO, text, strlen(text));
+    (void)ignored;
+}
+
+/**
+ * @brief Writes a number to stderr from the signal handler.
+ *
+ * @param value The number to write.
+ * @param base 10 or 16 (hexadecimal values get a 0x prefix).
+ */
+static void guard_write_number(uintptr_t value, unsigned base) {
+    char buffer[24];
+    int pos = sizeof(buffer);
+    buffer[--pos] = '\0';
+    do {
+        buffer[--pos] = "0123456789abcdef"[value % base];
+        value /= base;
+    } while (value);
+    if (base == 16) {
+        buffer[--pos] = 'x';
+        buffer[--pos] = '0';
+    }
+    guard_write(buffer + pos);
+}
+
+/**
+ * @brief Writes a stack recorded for a guarded slot from the signal handler.
+ *
+ * @param what "allocated" or "freed".
+ * @param tid Thread that performed the operation.
+ * @param stack Recorded frames.
+ * @param depth Number of frames.
+ */
+static void guard_write_stack(const char *what, pid_t tid, void *const *stack, int depth) {
+    guard_write("[guard]   ");
+    guard_write(what);
+    guard_write(" by thread ");
+    guard_write_number((uintptr_t)tid, 10);
+    guard_write(":\n");
+    for (int i = 0; i < depth; i++) {
+        guard_write("[guard]     #");
+        guard_write_number((uintptr_t)i, 10);
+        guard_write(" ");
+        guard_write_number((uintptr_t)stack[i], 16);
+        guard_write("\n");
+    }
+}
+
+/**
+ * @brief Describes a fault inside the guarded pool using only async-signal-safe calls.
+ *
+ * A fault in a freed slot is a use-after-free. A fault in a guard page is
+ * attributed to the block on its left (overflow, blocks are right-aligned)
+ * or, if there is none, to the block on its right (underflow).
+ *
+ * @param addr The faulting address.
+ */
+static void guard_report_fault(uintptr_t addr) {
+    size_t page_index = (addr - guard_pool_start) / guard_page_size;
+    GuardSlot *slot;
+    const char *kind;
+
+    if (page_index % 2) {
+        slot = &guard_slots[page_index / 2];
+        kind = slot->state == GUARD_SLOT_FREED ? "use-after-free" : "invalid access";
+    } else {
+        GuardSlot *left = page_index > 0 ? &guard_slots[page_index / 2 - 1] : NULL;
+        GuardSlot *right = page_index / 2 < guard_slot_count ? &guard_slots[page_index / 2] : NULL;
+        if (left && left->state != GUARD_SLOT_UNUSED) {
+            slot = left;
+            kind = "heap-buffer-overflow";
+        } else {
+            slot = right;
+            kind = "heap-buffer-underflow";
+        }
+    }
+
+    guard_write("[guard] ");
+    guard_write(kind);
+    guard_write(" at ");
+    guard_write_number(addr, 16);
+    if (!slot || slot->state == GUARD_SLOT_UNUSED) {
+        guard_write(" (no block nearby)\n");
+        return;
+    }
+    if (addr >= slot->ptr + slot->size) {
+        guard_write(", ");
+        guard_write_number(addr - (slot->ptr + slot->size), 10);
+        guard_write(" bytes after ");
+    } else if (addr < slot->ptr) {
+        guard_write(", ");
+        guard_write_number(slot->ptr - addr, 10);
+        guard_write(" bytes before ");
+    } else {
+        guard_write(", offset ");
+        guard_write_number(addr - slot->ptr, 10);
+        guard_write(" in ");
+    }
+    guard_write_number(slot->size, 10);
+    guard_write("-byte block ");
+    guard_write_number(slot->ptr, 16);
+    guard_write(slot->state == GUARD_SLOT_FREED ? " (freed)\n" : "\n");
+    guard_write_stack("allocated", slot->alloc_tid, slot->alloc_stack, slot->alloc_depth);
+    if (slot->state == GUARD_SLOT_FREED) {
+        guard_write_stack("freed", slot->free_tid, slot->free_stack, slot->free_depth);
+    }
+}
+
+/**
+ * @brief SIGSEGV handler that reports faults inside the guarded pool.
+ *
+ * After a report the previous disposition is restored and the handler
+ * returns, so the faulting access is retried and the process terminates
+ * (or is handled) as it would without the monitor. Faults outside the
+ * pool are forwarded to the previous handler.
+ *
+ * @param sig Signal number.
+ * @param info Fault information (si_addr is the faulting address).
+ * @param context Signal context.
+ */
+static void guard_signal_handler(int sig, siginfo_t *info, void *context) {
+    if (guard_owns(info->si_addr)) {
+        guard_report_fault((uintptr_t)info->si_addr);
+        sigaction(SIGSEGV, &guard_previous_action, NULL);
+        return;
+    }
+    if (guard_previous_action.sa_flags & SA_SIGINFO) {
+        guard_previous_action.sa_sigaction(sig, info, context);
+    } else if (guard_previous_action.sa_handler != SIG_DFL && guard_previous_action.sa_handler != SIG_IGN) {
+        guard_previous_action.sa_handler(sig);
+    } else {
+        sigaction(SIGSEGV, &guard_previous_action, NULL);
+    }
+}
+
+/**
+ * @brief Reserves the guarded pool and installs the SIGSEGV handler if MEMORY_MONITOR_GUARD_SAMPLE is set.
+ */
+static void guard_start() {
+    unsigned long rate = env_number("MEMORY_MONITOR_GUARD_SAMPLE", 0);
+    if (rate == 0) return;
+    size_t count = env_number("MEMORY_MONITOR_GUARD_SLOTS", 64);
+    if (count == 0) count = 64;
+
+    guard_page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t pool_size = (2 * count + 1) * guard_page_size;
+    void *pool = real_mmap(NULL, pool_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    void *slots = real_mmap(NULL, count * sizeof(GuardSlot), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pool == MAP_FAILED || slots == MAP_FAILED) {
+        safe_log("[guard] cannot reserve %zu guarded slots\n", count);
+        if (pool != MAP_FAILED) real_munmap(pool, pool_size);
+        if (slots != MAP_FAILED) real_munmap(slots, count * sizeof(GuardSlot));
+        return;
+    }
+
+    struct sigaction action = { .sa_sigaction = guard_signal_handler, .sa_flags = SA_SIGINFO | SA_ONSTACK };
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGSEGV, &action, &guard_previous_action) == -1) {
+        safe_log("[guard] cannot install SIGSEGV handler\n");
+        real_munmap(pool, pool_size);
+        real_munmap(slots, count * sizeof(GuardSlot));
+        return;
+    }
+
+    void *frames[1];
+    backtrace(frames, 1);
+    guard_slots = slots;
+    guard_slot_count = count;
+    guard_pool_start = (uintptr_t)pool;
+    guard_pool_end = guard_pool_start + pool_size;
+    guard_sample_rate = rate;
+    safe_log("[guard] sampling 1 in %lu allocations into %zu guarded slots\n", rate, count);
+}
+
+/**
+ * @brief Starts sampling the placement of a large block or mapping.
+ *
+ * Records the calling thread and the node of the CPU it runs on (getcpu
+ * is served by the vDSO). Regions beyond NUMA_REGIONS are only counted.
+ *
+ * @param start Start of the region.
+ * @param length Length of the region in bytes.
+ * @param kind NUMA_KIND_MALLOC or NUMA_KIND_MMAP.
+ */
+static void numa_track(const void *start, size_t length, int kind) {
+    unsigned cpu = 0, node = 0;
+    getcpu(&cpu, &node);
+    pthread_mutex_lock(&numa_lock);
+    NumaRegion *region = NULL;
+    for (unsigned i = 0; i < NUMA_REGIONS; i++) {
+        if (!numa_regions[i].id) {
+            region = &numa_regions[i];
+            break;
+        }
+    }
+    if (region) {
+        *region = (NumaRegion){ .id = ++numa_last_id, .start = (uintptr_t)start, .length = length,
+                                .kind = kind, .tid = current_tid(), .cpu_node = (int)node };
+    } else {
+        numa_dropped++;
+    }
+    pthread_mutex_unlock(&numa_lock);
+}
+
+/**
+ * @brief Stops sampling the parts of regions that overlap a released range.
+ *
+ * Regions fully inside the range are dropped and partially unmapped ones
+ * are trimmed (a hole in the middle keeps only the part before it).
+ *
+ * @param start Start of the released range.
+ * @param length Length of the released range.
+ */
+static void numa_untrack(const void *start, size_t length) {
+    uintptr_t begin = (uintptr_t)start;
+    uintptr_t end = begin + length;
+    pthread_mutex_lock(&numa_lock);
+    for (unsigned i = 0; i < NUMA_REGIONS; i++) {
+        NumaRegion *region = &numa_regions[i];
+        uintptr_t region_end = region->start + region->length;
+        if (!region->id || region->start >= end || region_end <= begin) continue;
+        if (begin <= region->start && end >= region_end) {
+            region->id = 0;
+            continue;
+        }
+        if (begin <= region->start) {
+            region->length = region_end - end;
+            region->start = end;
+        } else {
+            region->length = begin - region->start;
+        }
+        region->generation++;
+        region->cursor = 0;
+        region->pass_absent = 0;
+        memset(region->pass_pages, 0, sizeof(region->pass_pages));
+    }
+    pthread_mutex_unlock(&numa_lock);
+}
+
+/**
+ * @brief Stores a node at position @p i of block_heap and records the position in its slot.
+ *
+ * @param i Heap position.
+ * @param node The node.
+ */
+static inline void block_heap_place(size_t i, BlockHeapNode node) {
+    block_heap[i] = node;
+    node.slot->heap_index = i + 1;
+}
+
+/**
+ * @brief Restores the block_heap order around position @p i after its key changed.
+ *
+ * @param i Heap position.
+ */
+static void block_heap_fix(size_t i) {
+    BlockHeapNode node = block_heap[i];
+    while (i > 0 && block_heap[(i - 1) / 2].size > node.size) {
+        block_heap_place(i, block_heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        size_t smallest = 2 * i + 1;
+        if (smallest >= block_heap_count) break;
+        if (smallest + 1 < block_heap_count && block_heap[smallest + 1].size < block_heap[smallest].size) smallest++;
+        if (block_heap[smallest].size >= node.size) break;
+        block_heap_place(i, block_heap[smallest]);
+        i = smallest;
+    }
+    block_heap_place(i, node);
+}
+
+/**
+ * @brief Offers a live block to block_heap.
+ *
+ * Must be called with alloc_lock held. O(log BLOCK_HEAP_SIZE).
+ *
+ * @param slot The block's allocation table slot.
+ * @param others Number of other live blocks; when all of them are members, any block may enter.
+ */
+static void block_heap_offer(Allocation *slot, uint64_t others) {
+    slot->heap_index = 0;
+    if (block_heap_count < BLOCK_HEAP_SIZE) {
+        if (block_heap_count < others && (!block_heap_count || slot->size <= block_heap[0].size)) return;
+        block_heap_place(block_heap_count++, (BlockHeapNode){ .size = slot->size, .slot = slot });
+        block_heap_fix(block_heap_count - 1);
+    } else if (slot->size > block_heap[0].size) {
+        block_heap[0].slot->heap_index = 0;
+        block_heap_place(0, (BlockHeapNode){ .size = slot->size, .slot = slot });
+        block_heap_fix(0);
+    }
+}
+
+/**
+ * @brief Adds a newly accounted block to block_heap.
+ *
+ * Must be called with alloc_lock held, after live_blocks counts the block.
+ *
+ * @param slot The block's allocation table slot.
+ */
+static inline void block_heap_insert(Allocation *slot) {
+    block_heap_offer(slot, live_blocks - 1);
+}
+
+/**
+ * @brief Removes a released block from block_heap.
+ *
+ * Must be called with alloc_lock held. The last node takes the block's
+ * position and is sifted up or down.
+ *
+ * @param slot The block's allocation table slot.
+ */
+static void block_heap_remove(Allocation *slot) {
+    if (!slot->heap_index) return;
+    size_t i = slot->heap_index - 1;
+    slot->heap_index = 0;
+    if (i != --block_heap_count) {
+        block_heap_place(i, block_heap[block_heap_count]);
+        block_heap_fix(i);
+    }
+}
+
+/**
+ * @brief Rebuilds block_heap from the allocation table.
+ *
+ * Must be called with alloc_lock held. O(table size); only run by a peak
+ * capture that finds fewer than PEAK_TOP_BLOCKS members while more blocks
+ * are live.
+ */
+static void block_heap_refill() {
+    for (size_t i = 0; i < block_heap_count; i++) block_heap[i].slot->heap_index = 0;
+    block_heap_count = 0;
+    size_t capacity = allocations ? (size_t)1 << allocation_bits : 0;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < capacity; i++) {
+        if (allocations[i].ptr) block_heap_offer(&allocations[i], seen++);
+    }
+}
+
+/**
+ * @brief Points the heap node of a block at its new table slot after the table moved the entry.
+ *
+ * @param slot The slot the entry was moved to.
+ */
+static inline void block_heap_moved(Allocation *slot) {
+    if (slot->heap_index) block_heap[slot->heap_index - 1].slot = slot;
+}
+
+/**
+ * @brief Finds the allocation table slot of a pointer.
+ *
+ * Must be called with alloc_lock held.
+ *
+ * @param ptr Pointer to the memory block.
+ * @return The slot holding @p ptr, or NULL if the pointer is not tracked.
+ */
+static Allocation *allocation_find(void *ptr) {
+    if (!allocations) return NULL;
+    size_t mask = ((size_t)1 << allocation_bits) - 1;
+    size_t index = hash_pointer(ptr, allocation_bits);
+    while (allocations[index].ptr) {
+        if (allocations[index].ptr == ptr) return &allocations[index];
+        index = (index + 1) & mask;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Doubles the allocation table (or creates it) and rehashes all entries.
+ *
+ * Must be called with alloc_lock held. The table memory comes from
+ * real_mmap, so it is neither tracked nor served by the monitored allocator.
+ *
+ * @return 0 on success, -1 if the new table could not be mapped.
+ */
+static int allocation_table_grow() {
+    unsigned bits = allocations ? allocation_bits + 1 : ALLOCATION_TABLE_INITIAL_BITS;
+    size_t capacity = (size_t)1 << bits;
+    Allocation *table = real_mmap(NULL, capacity * sizeof(Allocation), PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (table == MAP_FAILED) return -1;
+
+    if (allocations) {
+        size_t old_capacity = (size_t)1 << allocation_bits;
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (!allocations[i].ptr) continue;
+            size_t index = hash_pointer(allocations[i].ptr, bits);
+            while (table[index].ptr) {
+                index = (index + 1) & (capacity - 1);
+            }
+            table[index] = allocations[i];
+            block_heap_moved(&table[index]);
+        }
+        real_munmap(allocations, old_capacity * sizeof(Allocation));
+    }
+    allocations = table;
+    allocation_bits = bits;
+    return 0;
+}
+
+/**
+ * @brief Returns the slot for a new entry of @p ptr, growing the table when half full.
+ *
+ * Must be called with alloc_lock held. If @p ptr is already tracked (its
+ * free was never seen), its existing slot is returned.
+ *
+ * @param ptr Pointer to the memory block.
+ * @return The slot, or NULL if the table is full and cannot grow.
+ */
+static Allocation *allocation_slot(void *ptr) {
+    size_t capacity = allocations ? (size_t)1 << allocation_bits : 0;
+    if ((live_blocks + 1) * 2 > capacity && allocation_table_grow() == -1 && live_blocks + 1 >= capacity) {
+        return NULL;
+    }
+    size_t mask = ((size_t)1 << allocation_bits) - 1;
+    size_t index = hash_pointer(ptr, allocation_bits);
+    while (allocations[index].ptr && allocations[index].ptr != ptr) {
+        index = (index + 1) & mask;
+    }
+    return &allocations[index];
+}
+
+/**
+ * @brief Empties an allocation table slot using backward-shift deletion.
+ *
+ * Must be called with alloc_lock held. Following entries of the probe
+ * sequence are moved back so lookups never need tombstones.
+ *
+ * @param slot The slot to empty.
+ */
+static void allocation_erase(Allocation *slot) {
+    size_t mask = ((size_t)1 << allocation_bits) - 1;
+    size_t hole = (size_t)(slot - allocations);
+    size_t index = hole;
+    membership_remove(slot->ptr);
+    for (;;) {
+        index = (index + 1) & mask;
+        if (!allocations[index].ptr) break;
+        size_t home = hash_pointer(allocations[index].ptr, allocation_bits);
+        if (((index - home) & mask) >= ((index - hole) & mask)) {
+            allocations[hole] = allocations[index];
+            block_heap_moved(&allocations[hole]);
+            hole = index;
+        }
+    }
+    allocations[hole].ptr = NULL;
+}
+
+/**
+ * @brief Stores a site at position @p i of site_heap and records the position in the site.
+ *
+ * @param i Heap position.
+ * @param site The site.
+ */
+static inline void site_heap_place(unsigned i, Site *site) {
+    site_heap[i] = site;
+    site->heap_index = i + 1;
+}
+
+/**
+ * @brief Restores the site_heap order around position @p i after its key changed.
+ *
+ * @param i Heap position.
+ */
+static void site_heap_fix(unsigned i) {
+    Site *site = site_heap[i];
+    while (i > 0 && site_heap[(i - 1) / 2]->live_bytes < site->live_bytes) {
+        site_heap_place(i, site_heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        unsigned largest = 2 * i + 1;
+        if (largest >= site_heap_count) break;
+        if (largest + 1 < site_heap_count && site_heap[largest + 1]->live_bytes > site_heap[largest]->live_bytes) largest++;
+        if (site_heap[largest]->live_bytes <= site->live_bytes) break;
+        site_heap_place(i, site_heap[largest]);
+        i = largest;
+    }
+    site_heap_place(i, site);
+}
+
+/**
+ * @brief Updates site_heap after a site's live bytes changed.
+ *
+ * Must be called with alloc_lock held. A site enters the heap with its
+ * first live block, is re-sifted (up or down) on every change and leaves
+ * it when its last live block is released. O(log SITE_TABLE_SIZE).
+ *
+ * @param site The site.
+ */
+static void site_heap_update(Site *site) {
+    if (!site->heap_index) {
+        if (!site->live_bytes) return;
+        site_heap_place(site_heap_count++, site);
+        site_heap_fix(site_heap_count - 1);
+    } else if (site->live_bytes) {
+        site_heap_fix(site->heap_index - 1);
+    } else {
+        unsigned i = site->heap_index - 1;
+        site->heap_index = 0;
+        if (i != --site_heap_count) {
+            site_heap_place(i, site_heap[site_heap_count]);
+            site_heap_fix(i);
+        }
+    }
+}
+
+/**
+ * @brief Copies the largest blocks and sites into peak_snapshot.
+ *
+ * Must be called with alloc_lock held. The largest blocks are the largest
+ * members of block_heap, sorted by insertion; block_heap is refilled from
+ * the table first if it has run low. The top entries of the site max-heap
+ * are visited best-first: a frontier holds the children of the entries
+ * taken so far and the largest of them is taken next, so the snapshot
+ * comes out sorted and costs O(BLOCK_HEAP_SIZE * PEAK_TOP_BLOCKS +
+ * PEAK_TOP_SITES^2).
+ *
+ * The live total is compared with peak_total_alloc first. If the total is
+ * above it, a concurrent mmap is raising the peak and peak_pending is
+ * re-armed so the next decrease captures again. If it is below, an
+ * munmap or mremap (which do not take alloc_lock) released bytes between
+ * the peak and the capture; the snapshot is then the closest state
+ * available and missed_bytes says by how much it falls short.
+ */
+static void peak_capture() {
+    PeakSnapshot *snapshot = &peak_snapshot;
+    size_t frontier[PEAK_TOP_SITES + 1];
+    unsigned frontier_count = 0;
+
+    size_t live = atomic_load_explicit(&live_total_bytes, memory_order_relaxed);
+    size_t peak = atomic_load_explicit(&peak_total_alloc, memory_order_relaxed);
+    if (live > peak) atomic_store_explicit(&peak_pending, 1, memory_order_relaxed);
+    snapshot->captured = 1;
+    snapshot->total_bytes = peak;
+    snapshot->missed_bytes = live < peak ? peak - live : 0;
+    snapshot->malloc_bytes = atomic_load_explicit(&total_malloc_alloc, memory_order_relaxed);
+    snapshot->mmap_bytes = atomic_load_explicit(&live_mmap_bytes, memory_order_relaxed);
+    snapshot->live_blocks = live_blocks;
+
+    if (block_heap_count < PEAK_TOP_BLOCKS && block_heap_count < live_blocks) block_heap_refill();
+    snapshot->block_count = 0;
+    for (size_t i = 0; i < block_heap_count; i++) {
+        const Allocation *block = block_heap[i].slot;
+        unsigned j = snapshot->block_count < PEAK_TOP_BLOCKS ? snapshot->block_count++ : PEAK_TOP_BLOCKS;
+        while (j > 0 && snapshot->blocks[j - 1].size < block->size) {
+            if (j < PEAK_TOP_BLOCKS) snapshot->blocks[j] = snapshot->blocks[j - 1];
+            j--;
+        }
+        if (j < PEAK_TOP_BLOCKS) snapshot->blocks[j] = *block;
+    }
+
+    snapshot->site_count = 0;
+    if (site_heap_count) frontier[frontier_count++] = 0;
+    while (frontier_count && snapshot->site_count < PEAK_TOP_SITES) {
+        unsigned best = 0;
+        for (unsigned i = 1; i < frontier_count; i++) {
+            if (site_heap[frontier[i]]->live_bytes > site_heap[frontier[best]]->live_bytes) best = i;
+        }
+        size_t node = frontier[best];
+        frontier[best] = frontier[--frontier_count];
+        snapshot->sites[snapshot->site_count++] = *site_heap[node];
+        for (size_t child = 2 * node + 1; child <= 2 * node + 2 && child < site_heap_count; child++) {
+            frontier[frontier_count++] = child;
+        }
+    }
+}
+
+/**
+ * @brief Adds live bytes of one kind and raises the high-water marks.
+ *
+ * Lock-free: the counters are updated with atomic adds and the marks with
+ * compare-and-swap, so every mark is exact. Reaching a new combined peak
+ * only sets peak_pending.
+ *
+ * @param live Live bytes of the kind (total_malloc_alloc or live_mmap_bytes).
+ * @param peak High-water mark of the kind.
+ * @param bytes Bytes added.
+ */
+static inline void grow_live(_Atomic size_t *live, _Atomic size_t *peak, size_t bytes) {
+    raise_peak(peak, atomic_fetch_add_explicit(live, bytes, memory_order_relaxed) + bytes);
+    size_t total = atomic_fetch_add_explicit(&live_total_bytes, bytes, memory_order_relaxed) + bytes;
+    if (raise_peak(&peak_total_alloc, total)) {
+        atomic_store_explicit(&peak_pending, 1, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Removes live bytes of one kind, capturing the peak state first if a peak is pending.
+ *
+ * The first decrease after a new peak still sees the peak state, so it is
+ * captured then; decreases without a pending peak cost one load. A
+ * pending peak is claimed and captured under alloc_lock and the decrease
+ * is applied before the lock is released, so an unlocked caller (munmap,
+ * mremap) that sees the pending peak cannot shrink the state before it is
+ * captured. An unlocked decrease that ran before the peak was flagged is
+ * reported by peak_capture() in missed_bytes.
+ *
+ * @param live Live bytes of the kind (total_malloc_alloc or live_mmap_bytes).
+ * @param bytes Bytes removed (clamped to the live bytes).
+ * @param locked Whether the caller holds alloc_lock.
+ */
+static inline void shrink_live(_Atomic size_t *live, size_t bytes, int locked) {
+    int capture = atomic_load_explicit(&peak_pending, memory_order_relaxed);
+    if (capture) {
+        if (!locked) pthread_mutex_lock(&alloc_lock);
+        if (atomic_exchange_explicit(&peak_pending, 0, memory_order_relaxed)) peak_capture();
+    }
+    size_t seen = atomic_load_explicit(live, memory_order_relaxed);
+    size_t removed;
+    do {
+        removed = bytes < seen ? bytes : seen;
+    } while (!atomic_compare_exchange_weak_explicit(live, &seen, seen - removed, memory_order_relaxed, memory_order_relaxed));
+    atomic_fetch_sub_explicit(&live_total_bytes, removed, memory_order_relaxed);
+    if (capture && !locked) pthread_mutex_unlock(&alloc_lock);
+}
+
+/**
+ * @brief Adds a live block to the aggregated counters.
+ *
+ * Must be called with alloc_lock held.
+ *
+ * @param entry The table slot of the block being accounted.
+ */
+static void account_block(Allocation *entry) {
+    entry->site->live_bytes += entry->size;
+    entry->site->live_blocks++;
+    thread_stats[entry->thread].live_bytes += entry->size;
+    thread_stats[entry->thread].live_blocks++;
+    if (numa_enabled && entry->size >= numa_min_bytes) numa_track(entry->ptr, entry->size, NUMA_KIND_MALLOC);
+    grow_live(&total_malloc_alloc, &peak_malloc_bytes, entry->size);
+    live_blocks++;
+    size_histogram[size_bucket(entry->size)]++;
+    block_heap_insert(entry);
+    site_heap_update(entry->site);
+}
+
+/**
+ * @brief Removes a live block from the aggregated counters.
+ *
+ * Must be called with alloc_lock held.
+ *
+ * @param entry The table slot of the block being released.
+ */
+static void unaccount_block(Allocation *entry) {
+    shrink_live(&total_malloc_alloc, entry->size, 1);
+    block_heap_remove(entry);
+    entry->site->live_bytes -= entry->size;
+    entry->site->live_blocks--;
+    thread_stats[entry->thread].live_bytes -= entry->size;
+    thread_stats[entry->thread].live_blocks--;
+    if (numa_enabled && entry->size >= numa_min_bytes) numa_untrack(entry->ptr, entry->size);
+    live_blocks--;
+    size_histogram[size_bucket(entry->size)]--;
+    site_heap_update(entry->site);
+    if (!thread_stats[entry->thread].live_blocks) thread_slot_release(entry->thread);
+}
+
+/**
+ * @brief Stores a tracked block in the allocation table and accounts it.
+ *
+ * Must be called with alloc_lock held. A stale entry for the same pointer
+ * is released first.
+ *
+ * @param entry The block to store (entry->site must be set).
+ */
+static void insert_allocation(const Allocation *entry) {
+    Allocation *slot = allocation_slot(entry->ptr);
+    if (!slot) return;
+    if (slot->ptr) {
+        unaccount_block(slot);
+    } else {
+        membership_add(entry->ptr);
+    }
+    *slot = *entry;
+    account_block(slot);
+}
+
+/**
+ * @brief Adds a new allocation entry to the allocation table.
+ *
+ * @param ptr Pointer returned by the memory allocation function (malloc/calloc/realloc).
+ * @param size The size of the allocated memory in bytes.
+ * @param caller Return address of the intercepted call (the call site).
+ */
+static void add_allocation(void *ptr, size_t size, void *caller) {
+    Allocation entry = { .ptr = ptr, .size = size, .thread = current_thread_slot() };
+    pthread_mutex_lock(&alloc_lock);
+    entry.site = site_lookup(caller);
+    entry.site->allocations++;
+    thread_stats[entry.thread].allocations++;
+    malloc_calls++;
+    insert_allocation(&entry);
+    pthread_mutex_unlock(&alloc_lock);
+}
+
+/**
+ * @brief Adds a new allocation to the table if the tracking filters select it.
+ *
+ * @param ptr Pointer returned by the memory allocation function.
+ * @param size The size of the allocated memory in bytes.
+ * @param caller Return address of the intercepted call (the call site).
+ */
+static inline void track_allocation(void *ptr, size_t size, void *caller) {
+    if (filter_tracks(size, caller)) {
+        add_allocation(ptr, size, caller);
+    } else {
+        forget_free(ptr);
+    }
+}
+
+/**
+ * @brief Removes a block from the allocation table before a realloc, without counting a free.
+ *
+ * The old address is remembered in freed_history as a pending free under
+ * the same lock, before the realloc can hand it back to the allocator:
+ * an untracked allocation that gets the address in the meantime then
+ * finds the entry and drops it in forget_free(). restore_allocation()
+ * rolls this back when the block stays where it was.
+ *
+ * @param ptr Pointer to the memory block.
+ * @param removed Receives a copy of the removed entry.
+ * @param caller Return address of the realloc call.
+ * @return 1 if the block was tracked, 0 otherwise.
+ */
+static int detach_allocation(void *ptr, Allocation *removed, void *caller) {
+    FreeStack stack;
+    free_stack_capture(&stack, caller);
+    pthread_mutex_lock(&alloc_lock);
+    Allocation *slot = allocation_find(ptr);
+    if (slot) {
+        *removed = *slot;
+        unaccount_block(slot);
+        allocation_erase(slot);
+        remember_free(ptr, caller, &stack);
+    }
+    pthread_mutex_unlock(&alloc_lock);
+    return slot != NULL;
+}
+
+/**
+ * @brief Puts back a block removed by detach_allocation() after a failed realloc.
+ *
+ * @param old The removed entry.
+ */
+static void restore_allocation(const Allocation *old) {
+    pthread_mutex_lock(&alloc_lock);
+    freed_history_drop(old->ptr);
+    insert_allocation(old);
+    pthread_mutex_unlock(&alloc_lock);
+}
+
+/**
+ * @brief Removes an allocation entry from the table when the memory is freed.
+ *
+ * @param ptr Pointer to the memory block that is being freed.
+ * @param caller Return address of the free call.
+ * @return 1 if the block was tracked, 0 otherwise.
+ */
+static int remove_allocation(void *ptr, void *caller) {
+    unsigned consumer = current_thread_slot();
+    FreeStack stack;
+    free_stack_capture(&stack, caller);
+    pthread_mutex_lock(&alloc_lock);
+    Allocation *slot = allocation_find(ptr);
+    if (slot) {
+        count_thread_free(consumer, slot->thread);
+        unaccount_block(slot);
+        allocation_erase(slot);
+        remember_free(ptr, caller, &stack);
+        free_calls++;
+    }
+    pthread_mutex_unlock(&alloc_lock);
+    return slot != NULL;
+}
+
+/**
+ * @brief Reconciles a batch of deferred frees and releases the blocks.
+ *
+ * The entries are removed under a single alloc_lock acquisition. Table
+ * slots are prefetched FREE_PREFETCH_GROUP at a time before being probed,
+ * so the cache misses of a group overlap. Must be called with the batch
+ * lock held.
+ *
+ * @param batch The batch to flush.
+ */
+static void flush_free_batch(FreeBatch *batch) {
+    uint64_t untracked = 0;
+    if (batch->count == 0) return;
+
+    pthread_mutex_lock(&alloc_lock);
+    for (size_t group = 0; group < batch->count; group += FREE_PREFETCH_GROUP) {
+        size_t end = group + FREE_PREFETCH_GROUP < batch->count ? group + FREE_PREFETCH_GROUP : batch->count;
+        if (allocations) {
+            for (size_t i = group; i < end; i++) {
+                __builtin_prefetch(&allocations[hash_pointer(batch->ptrs[i], allocation_bits)], 1);
+            }
+        }
+        for (size_t i = group; i < end; i++) {
+            Allocation *slot = allocation_find(batch->ptrs[i]);
+            if (slot) {
+                count_thread_free(batch->thread, slot->thread);
+                unaccount_block(slot);
+                allocation_erase(slot);
+                remember_free(batch->ptrs[i], batch->callers[i], &batch->stacks[i]);
+                free_calls++;
+            } else {
+                untracked |= 1ULL << i;
+            }
+        }
+    }
+    pthread_mutex_unlock(&alloc_lock);
+
+    for (size_t i = 0; i < batch->count; i++) {
+        if (!(untracked & (1ULL << i)) || !report_bad_free(batch->ptrs[i], batch->callers[i])) {
+            call_real_free(batch->ptrs[i]);
+        }
+    }
+    batch->count = 0;
+}
+
+/**
+ * @brief Reconciles the deferred frees of all threads with the allocation table.
+ */
+static void flush_free_batches() {
+    if (!defer_frees) return;
+    pthread_mutex_lock(&free_batches_lock);
+    for (FreeBatch *batch = free_batches; batch; batch = batch->next) {
+        pthread_mutex_lock(&batch->lock);
+        flush_free_batch(batch);
+        pthread_mutex_unlock(&batch->lock);
+    }
+    pthread_mutex_unlock(&free_batches_lock);
+}
+
+/**
+ * @brief Thread exit destructor: flushes and unregisters the thread's batch.
+ *
+ * @param arg The exiting thread's FreeBatch.
+ */
+static void free_batch_thread_exit(void *arg) {
+    FreeBatch *batch = arg;
+    pthread_mutex_lock(&free_batches_lock);
+    for (FreeBatch **link = &free_batches; *link; link = &(*link)->next) {
+        if (*link == batch) {
+            *link = batch->next;
+            break;
+        }
+    }
+    pthread_mutex_lock(&batch->lock);
+    flush_free_batch(batch);
+    batch->registered = 0;
+    batch->exited = 1;
+    pthread_mutex_unlock(&batch->lock);
+    pthread_mutex_unlock(&free_batches_lock);
+}
+
+/**
+ * @brief fork() child handler: resets the batch locks, which may have been held by other threads.
+ *
+ * The batches of threads that do not exist in the child stay registered;
+ * their blocks were freed by the program and are released on the next flush.
+ */
+static void free_batches_after_fork() {
+    pthread_mutex_init(&free_batches_lock, NULL);
+    for (FreeBatch *batch = free_batches; batch; batch = batch->next) {
+        pthread_mutex_init(&batch->lock, NULL);
+    }
+}
+
+/**
+ * @brief Buffers a free in the calling thread's batch, flushing the batch when it fills.
+ *
+ * Frees made by the thread after its exit destructor ran (e.g. while glibc
+ * tears down its TLS) are not deferred, because the batch memory is about
+ * to be released.
+ *
+ * @param ptr Pointer to the memory block that is being freed.
+ * @param caller Return address of the free call.
+ * @return 1 if the free was buffered, 0 if it must be processed immediately.
+ */
+static int defer_free(void *ptr, void *caller) {
+    FreeBatch *batch = &free_batch;
+    FreeStack stack;
+    if (batch->exited) return 0;
+    free_stack_capture(&stack, caller);
+    if (!batch->registered) {
+        batch->thread = current_thread_slot();
+        pthread_mutex_lock(&free_batches_lock);
+        batch->next = free_batches;
+        free_batches = batch;
+        batch->registered = 1;
+        pthread_mutex_unlock(&free_batches_lock);
+        pthread_setspecific(free_batch_key, batch);
+    }
+    pthread_mutex_lock(&batch->lock);
+    batch->ptrs[batch->count] = ptr;
+    batch->stacks[batch->count].depth = stack.depth;
+    memcpy(batch->stacks[batch->count].frames, stack.frames, stack.depth * sizeof(void *));
+    batch->callers[batch->count++] = caller;
+    if (batch->count == FREE_BATCH_SIZE) {
+        flush_free_batch(batch);
+    }
+    pthread_mutex_unlock(&batch->lock);
+    return 1;
+}
+
+/**
+ * @brief Reconciles the calling thread's deferred frees before its thread slot is released.
+ *
+ * Deferred frees the thread makes afterwards are counted in the shared slot.
+ */
+static void free_batch_release_slot() {
+    FreeBatch *batch = &free_batch;
+    if (!batch->registered) return;
+    pthread_mutex_lock(&batch->lock);
+    flush_free_batch(batch);
+    batch->thread = THREAD_SLOTS - 1;
+    pthread_mutex_unlock(&batch->lock);
+}
+
+/**
+ * @brief Records the outcome of a realloc of a tracked block.
+ *
+ * Stores the resized block and updates the realloc statistics of the
+ * calling site: whether the block moved, how many bytes were copied,
+ * the growth factor and the longest chain of growths of a single block.
+ * The block becomes owned by the calling thread; a move or an ownership
+ * change counts as a free of the old block by the calling thread. The
+ * old address was remembered as freed by detach_allocation(); a block
+ * resized in place is dropped from freed_history again.
+ *
+ * @param old Entry of the block before the realloc.
+ * @param new_ptr Pointer returned by realloc.
+ * @param size The new size of the block in bytes.
+ * @param caller Return address of the realloc call.
+ */
+static void resize_allocation(const Allocation *old, void *new_ptr, size_t size, void *caller) {
+    Allocation entry = { .ptr = new_ptr, .size = size, .reallocs = old->reallocs + 1, .thread = current_thread_slot() };
+    pthread_mutex_lock(&alloc_lock);
+    if (new_ptr != old->ptr || entry.thread != old->thread) {
+        count_thread_free(entry.thread, old->thread);
+    }
+    entry.site = site_lookup(caller);
+    Site *site = entry.site;
+    site->reallocs++;
+    if (new_ptr != old->ptr) {
+        thread_stats[entry.thread].allocations++;
+        site->realloc_moves++;
+        site->bytes_copied += old->size < size ? old->size : size;
+    } else {
+        freed_history_drop(old->ptr);
+    }
+    if (size > old->size) {
+        site->grown_from += old->size;
+        site->grown_to += size;
+        if (size - old->size < old->size / 2) site->small_growths++;
+    }
+    if (entry.reallocs > site->max_chain) site->max_chain = entry.reallocs;
+    realloc_calls++;
+    insert_allocation(&entry);
+    pthread_mutex_unlock(&alloc_lock);
+}
+
+/**
+ * @brief Logs the sites that wasted the most memcpy bandwidth in realloc.
+ *
+ * Sites are ranked by bytes copied by moving reallocs. A site whose blocks
+ * grew many times with small increments is marked as a candidate for
+ * reserving the final capacity up front.
+ */
+static void report_realloc_sites() {
+    Site *ranked[REALLOC_REPORT_SITES];
+    unsigned count = 0;
+    char name[256];
+
+    flush_free_batches();
+    pthread_mutex_lock(&alloc_lock);
+    for (unsigned i = 0; i <= SITE_TABLE_SIZE; i++) {
+        Site *site = i < SITE_TABLE_SIZE ? &sites[i] : &overflow_site;
+        if (site->reallocs == 0) continue;
+        unsigned pos = count < REALLOC_REPORT_SITES ? count++ : REALLOC_REPORT_SITES;
+        while (pos > 0 && ranked[pos - 1]->bytes_copied < site->bytes_copied) {
+            if (pos < REALLOC_REPORT_SITES) ranked[pos] = ranked[pos - 1];
+            pos--;
+        }
+        if (pos < REALLOC_REPORT_SITES) ranked[pos] = site;
+    }
+    pthread_mutex_unlock(&alloc_lock);
+
+    if (count == 0) return;
+    safe_log("[realloc] top %u sites by bytes copied:\n", count);
+    for (unsigned i = 0; i < count; i++) {
+        Site *site = ranked[i];
+        int reserve = site->max_chain >= REALLOC_CHAIN_THRESHOLD && site->small_growths >= REALLOC_CHAIN_THRESHOLD;
+        const char *module;
+        safe_log("[realloc] #%u site=%p (%s) hash=%016llx reallocs=%llu moved=%llu in_place=%llu copied=%zu bytes growth=%.2fx max_chain=%llu small_growths=%llu%s\n",
+                 i + 1, site->addr, describe_site(site->addr, name, sizeof(name)),
+                 (unsigned long long)site_identity(site->addr, &module),
+                 (unsigned long long)site->reallocs, (unsigned long long)site->realloc_moves,
+                 (unsigned long long)(site->reallocs - site->realloc_moves), site->bytes_copied,
+                 site->grown_from ? (double)site->grown_to / (double)site->grown_from : 0.0,
+                 (unsigned long long)site->max_chain, (unsigned long long)site->small_growths,
+                 reserve ? " | grows in small steps, reserve capacity up front" : "");
+    }
+}
+
+/**
+ * @brief Logs per-thread ownership statistics and the largest cross-thread free flows.
+ *
+ * Only printed when more than one thread used the allocator. The rate is
+ * the number of blocks created per second of the thread's lifetime.
+ */
+static void report_threads() {
+    ThreadStats stats[THREAD_SLOTS];
+    ThreadPair pairs[THREAD_REPORT_PAIRS];
+    unsigned slots = atomic_load_explicit(&thread_slots_used, memory_order_relaxed);
+    if (slots < 2) return;
+
+    flush_free_batches();
+    uint64_t now = monotonic_ns();
+    pthread_mutex_lock(&alloc_lock);
+    memcpy(stats, thread_stats, slots * sizeof(ThreadStats));
+    uint64_t started = threads_started;
+    pthread_mutex_unlock(&alloc_lock);
+
+    safe_log("[threads] %llu threads used the allocator%s\n", (unsigned long long)started,
+             slots == THREAD_SLOTS ? " (threads beyond the slots are reported as 'other'; slots of exited threads are reused)"
+                                   : " (slots of exited threads are reused)");
+    for (unsigned i = 0; i < slots; i++) {
+        uint64_t local = atomic_load_explicit(&thread_frees[i][i], memory_order_relaxed);
+        uint64_t remote = 0;
+        uint64_t freed_by_others = 0;
+        for (unsigned j = 0; j < slots; j++) {
+            if (j == i) continue;
+            remote += atomic_load_explicit(&thread_frees[i][j], memory_order_relaxed);
+            freed_by_others += atomic_load_explicit(&thread_frees[j][i], memory_order_relaxed);
+        }
+        uint64_t end = stats[i].exit_ns ? stats[i].exit_ns : now;
+        double seconds = end > stats[i].start_ns ? (double)(end - stats[i].start_ns) / 1e9 : 0.0;
+        char tid[16];
+        if (i < THREAD_SLOTS - 1) snprintf(tid, sizeof(tid), "%d", (int)stats[i].tid);
+        else snprintf(tid, sizeof(tid), "other");
+        safe_log("[threads] tid=%s%s live_bytes=%zu live_blocks=%llu allocations=%llu (%.0f/s) frees local=%llu remote=%llu freed_by_others=%llu\n",
+                 tid, stats[i].exit_ns ? " (exited)" : "", stats[i].live_bytes,
+                 (unsigned long long)stats[i].live_blocks, (unsigned long long)stats[i].allocations,
+                 seconds > 0.0 ? (double)stats[i].allocations / seconds : 0.0,
+                 (unsigned long long)local, (unsigned long long)remote, (unsigned long long)freed_by_others);
+    }
+
+    unsigned count = top_thread_pairs(pairs, THREAD_REPORT_PAIRS, slots);
+    for (unsigned i = 0; i < count; i++) {
+        safe_log("[threads] cross-thread frees: allocated by tid=%d freed by tid=%d: %llu\n",
+                 (int)stats[pairs[i].producer].tid, (int)stats[pairs[i].consumer].tid,
+                 (unsigned long long)pairs[i].frees);
+    }
+}
+
+/**
+ * @brief Logs the high-water marks and the largest blocks and sites at the combined peak.
+ */
+static void report_peak() {
+    flush_free_batches();
+    pthread_mutex_lock(&alloc_lock);
+    if (atomic_exchange_explicit(&peak_pending, 0, memory_order_relaxed)) peak_capture();
+    PeakSnapshot snapshot = peak_snapshot;
+    pthread_mutex_unlock(&alloc_lock);
+
+    safe_log("[peak] high-water marks: malloc=%zu bytes | mmap=%zu bytes | total=%zu bytes\n",
+             (size_t)peak_malloc_bytes, (size_t)peak_mmap_bytes, (size_t)peak_total_alloc);
+    if (!snapshot.captured) return;
+    safe_log("[peak] at the total peak: malloc=%zu bytes | mmap=%zu bytes | live_blocks=%llu\n",
+             snapshot.malloc_bytes, snapshot.mmap_bytes, (unsigned long long)snapshot.live_blocks);
+    if (snapshot.missed_bytes) {
+        safe_log("[peak] snapshot taken %zu bytes below the peak of %zu bytes (released concurrently by munmap or mremap)\n",
+                 snapshot.missed_bytes, snapshot.total_bytes);
+    }
+    char name[256];
+    for (unsigned i = 0; i < snapshot.block_count; i++) {
+        const Allocation *block = &snapshot.blocks[i];
+        char tid[16];
+        if (block->thread < THREAD_SLOTS - 1) snprintf(tid, sizeof(tid), "%d", (int)thread_stats[block->thread].tid);
+        else snprintf(tid, sizeof(tid), "other");
+        safe_log("[peak] block #%u ptr=%p size=%zu tid=%s site=%p (%s)\n", i + 1, block->ptr, block->size, tid,
+                 block->site->addr, describe_site(block->site->addr, name, sizeof(name)));
+    }
+    for (unsigned i = 0; i < snapshot.site_count; i++) {
+        const Site *site = &snapshot.sites[i];
+        const char *module;
+        safe_log("[peak] site #%u %p (%s) hash=%016llx live_bytes=%zu live_blocks=%llu\n", i + 1, site->addr,
+                 describe_site(site->addr, name, sizeof(name)), (unsigned long long)site_identity(site->addr, &module),
+                 site->live_bytes, (unsigned long long)site->live_blocks);
+    }
+}
+
+/**
+ * @brief Logs the monitoring overhead per operation type.
+ *
+ * "self" is the cost spent in the library (bookkeeping, logging,
+ * reporting hooks and the measurement itself), "real" the cost spent in
+ * the real functions, and "share" the library's part of the whole call.
+ */
+static void report_overhead() {
+    static const char *const names[] = MM_OVERHEAD_OP_NAMES;
+    OverheadTotals totals;
+    if (!overhead_mode) return;
+
+    overhead_collect(&totals);
+    if (overhead_mode == MM_OVERHEAD_CYCLES) {
+        safe_log("[overhead] measured with user-space cycles, instructions and cache misses (rdpmc)%s\n",
+                 overhead_unmeasured ? ", some threads could not open counters and are not included" : "");
+    } else {
+        safe_log("[overhead] measured in nanoseconds (clock fallback: %s)\n", overhead_fallback_reason);
+    }
+    for (int op = 0; op < MM_OVERHEAD_OPS; op++) {
+        uint64_t calls = totals.calls[op];
+        if (!calls) continue;
+        uint64_t self = totals.self[op][0];
+        uint64_t real = totals.real[op][0];
+        double share = self + real ? 100.0 * (double)self / (double)(self + real) : 0.0;
+        if (overhead_mode == MM_OVERHEAD_CYCLES) {
+            safe_log("[overhead] %s calls=%llu self=%llu cycles (%.1f/call) instructions=%.1f/call cache_misses=%.2f/call"
+                     " | real=%llu cycles (%.1f/call) | share=%.1f%%\n",
+                     names[op], (unsigned long long)calls, (unsigned long long)self, (double)self / calls,
+                     (double)totals.self[op][1] / calls, (double)totals.self[op][2] / calls,
+                     (unsigned long long)real, (double)real / calls, share);
+        } else {
+            safe_log("[overhead] %s calls=%llu self=%llu ns (%.1f/call) | real=%llu ns (%.1f/call) | share=%.1f%%\n",
+                     names[op], (unsigned long long)calls, (unsigned long long)self, (double)self / calls,
+                     (unsigned long long)real, (double)real / calls, share);
+        }
+    }
+}
+
+/**
+ * @brief Reads a numeric configuration value from the environment.
+ *
+ * @param name Name of the environment variable.
+ * @param fallback Value returned when the variable is unset or invalid.
+ * @return The parsed value or @p fallback.
+ */
+static unsigned long env_number(const char *name, unsigned long fallback) {
+    const char *value = getenv(name);
+    char *end;
+    if (!value || !*value) return fallback;
+    unsigned long parsed = strtoul(value, &end, 10);
+    return *end == '\0' ? parsed : fallback;
+}
+
+/**
+ * @brief Starts one of the library's background threads.
+ *
+ * The thread is created with all signals blocked so it never runs the
+ * monitored program's signal handlers.
+ *
+ * @param thread Receives the thread handle.
+ * @param start Thread body.
+ * @return 0 on success, or an error number from pthread_create().
+ */
+static int start_background_thread(pthread_t *thread, void *(*start)(void *)) {
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int ret = pthread_create(thread, NULL, start, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return ret;
+}
+
+/**
+ * @brief Copies a configured path, replacing every "%p" with the process ID.
+ *
+ * Lets many monitored processes (a parent and the children that inherit
+ * LD_PRELOAD) share one configuration without writing to the same file.
+ *
+ * @param path Configured path.
+ * @param out Receives the expanded path, truncated to @p size bytes.
+ * @param size Size of @p out in bytes.
+ * @return Length of the expanded path.
+ */
+static size_t expand_pid_path(const char *path, char *out, size_t size) {
+    size_t length = 0;
+    for (const char *c = path; *c && length + 1 < size; c++) {
+        if (c[0] == '%' && c[1] == 'p') {
+            int n = snprintf(out + length, size - length, "%d", (int)getpid());
+            length = n > 0 && (size_t)n < size - length ? length + n : size - 1;
+            c++;
+        } else {
+            out[length++] = *c;
+        }
+    }
+    out[length] = '\0';
+    return length;
+}
+
+/**
+ * @brief Creates and maps the snapshot ring file.
+ *
+ * The file is locked with flock() for the lifetime of the process before it
+ * is truncated, so a child that inherits LD_PRELOAD and the same path cannot
+ * truncate a ring the parent still has mapped; it leaves the ring disabled
+ * instead. After the lock is taken the file is truncated and sized for
+ * @p capacity records, so all slots start with a zero sequence word.
+ *
+ * @param path Path of the ring file (MEMORY_MONITOR_RING, "%p" expanded).
+ * @param capacity Number of record slots (MEMORY_MONITOR_RING_RECORDS).
+ * @return 0 on success, -1 on failure.
+ */
+static int ring_open(const char *path, uint64_t capacity) {
+    size_t size = sizeof(MMRingHeader) + capacity * sizeof(MMRingRecord);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        safe_log("[ring] cannot open %s\n", path);
+        return -1;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+        MMRingHeader owner;
+        if (pread(fd, &owner, sizeof(owner), 0) == (ssize_t)sizeof(owner) && owner.magic == MM_RING_MAGIC) {
+            safe_log("[ring] %s is in use by process %lld, add %%p to MEMORY_MONITOR_RING for one ring per process\n",
+                     path, (long long)owner.pid);
+        } else {
+            safe_log("[ring] %s is locked by another process\n", path);
+        }
+        close(fd);
+        return -1;
+    }
+    if (ftruncate(fd, 0) == -1 || ftruncate(fd, size) == -1) {
+        safe_log("[ring] cannot resize %s to %zu bytes\n", path, size);
+        close(fd);
+        return -1;
+    }
+    void *map = real_mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        safe_log("[ring] cannot map %s\n", path);
+        close(fd);
+        return -1;
+    }
+
+    MMRingHeader *header = map;
+    header->version = MM_RING_VERSION;
+    header->record_size = sizeof(MMRingRecord);
+    header->overhead_unit = (uint32_t)overhead_mode;
+    header->capacity = capacity;
+    header->interval_ms = ring_interval_ms;
+    header->pid = getpid();
+    atomic_store_explicit(&header->head, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    header->magic = MM_RING_MAGIC;
+    ring = header;
+    ring_map_size = size;
+    ring_fd = fd;
+    ring_pid = getpid();
+    return 0;
+}
+
+/**
+ * @brief Appends one snapshot record to the ring file.
+ *
+ * Only one thread writes at a time (the ring thread, or fini_library() after
+ * joining it), so the record is filled with plain stores bracketed by the
+ * sequence word and published by advancing the header's head. Deferred
+ * frees are reconciled first, so every record carries exact counters.
+ */
+static void ring_write() {
+    MemoryStats stats;
+    OverheadTotals overhead;
+    struct timespec now;
+
+    flush_free_batches();
+    collect_stats(&stats);
+    overhead_collect(&overhead);
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    uint64_t index = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    MMRingRecord *record = (MMRingRecord *)(ring + 1) + index % ring->capacity;
+    atomic_store_explicit(&record->seq, 2 * index + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    record->timestamp_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    record->malloc_bytes = stats.malloc_bytes;
+    record->mmap_bytes = stats.mmap_bytes;
+    record->peak_bytes = stats.peak_bytes;
+    record->malloc_calls = stats.malloc_calls;
+    record->free_calls = stats.free_calls;
+    record->mmap_calls = stats.mmap_calls;
+    record->munmap_calls = stats.munmap_calls;
+    record->live_blocks = stats.live_blocks;
+    memcpy(record->histogram, stats.histogram, sizeof(record->histogram));
+    for (int op = 0; op < MM_OVERHEAD_OPS; op++) {
+        record->overhead_calls[op] = overhead.calls[op];
+        record->overhead_self[op] = overhead.self[op][0];
+        record->overhead_real[op] = overhead.real[op][0];
+    }
+    atomic_store_explicit(&record->seq, 2 * index + 2, memory_order_release);
+    atomic_store_explicit(&ring->head, index + 1, memory_order_release);
+}
+
+/**
+ * @brief Body of the ring thread: writes a record every ring_interval_ms.
+ *
+ * @param arg Unused.
+ * @return Always NULL.
+ */
+static void *ring_thread_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&ring_lock);
+    while (!ring_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += ring_interval_ms / 1000;
+        deadline.tv_nsec += (ring_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (!ring_stop && pthread_cond_timedwait(&ring_cond, &ring_lock, &deadline) != ETIMEDOUT);
+        if (ring_stop) break;
+        pthread_mutex_unlock(&ring_lock);
+        ring_write();
+        pthread_mutex_lock(&ring_lock);
+    }
+    pthread_mutex_unlock(&ring_lock);
+    return NULL;
+}
+
+/**
+ * @brief Opens the ring file and starts the ring thread if MEMORY_MONITOR_RING is set.
+ */
+static void ring_start() {
+    const char *path = getenv("MEMORY_MONITOR_RING");
+    if (!path || !*path) return;
+
+    ring_interval_ms = env_number("MEMORY_MONITOR_RING_INTERVAL_MS", 1000);
+    if (ring_interval_ms <= 0) ring_interval_ms = 1000;
+    uint64_t capacity = env_number("MEMORY_MONITOR_RING_RECORDS", 4096);
+    if (capacity == 0) capacity = 4096;
+    char expanded[PATH_MAX];
+    expand_pid_path(path, expanded, sizeof(expanded));
+    if (ring_open(expanded, capacity) == -1) return;
+
+    if (start_background_thread(&ring_thread, ring_thread_main) != 0) {
+        safe_log("[ring] cannot start snapshot thread, records are written at exit only\n");
+        ring_stop = 1;
+    }
+    safe_log("[ring] writing %lu records every %ld ms to %s\n", (unsigned long)capacity, ring_interval_ms, expanded);
+}
+
+/**
+ * @brief Stops the ring thread, appends a final record and unmaps the ring file.
+ *
+ * Forked children inherit the mapping but not the thread, so only the
+ * process that created the ring finalizes it.
+ */
+static void ring_finish() {
+    if (!ring || ring_pid != getpid()) return;
+
+    pthread_mutex_lock(&ring_lock);
+    int started = !ring_stop;
+    ring_stop = 1;
+    pthread_cond_signal(&ring_cond);
+    pthread_mutex_unlock(&ring_lock);
+    if (started) {
+        pthread_join(ring_thread, NULL);
+    }
+
+    ring_write();
+    real_munmap(ring, ring_map_size);
+    close(ring_fd);
+    ring = NULL;
+    ring_fd = -1;
+}
+
+/**
+ * @brief Queries the placement of the next pages within the per-tick budget.
+ *
+ * Regions are visited round-robin from numa_cursor, so a tick resumes
+ * where the previous one stopped. numa_lock is released around
+ * move_pages(), which only reports the node of present pages and never
+ * faults them in. A region released meanwhile is detected by its ID and
+ * one trimmed meanwhile by its generation; the results of the query are
+ * then discarded, since the pages may no longer belong to the region.
+ *
+ * @param budget Maximum number of pages to query.
+ * @return Number of pages queried, or -1 if move_pages() is unavailable.
+ */
+static long numa_tick(size_t budget) {
+    void *pages[NUMA_QUERY_CHUNK];
+    int status[NUMA_QUERY_CHUNK];
+    size_t page_size = (size_t)getpagesize();
+    long queried = 0;
+    unsigned visited = 0;
+
+    while ((size_t)queried < budget && visited < NUMA_REGIONS) {
+        pthread_mutex_lock(&numa_lock);
+        NumaRegion *region = &numa_regions[numa_cursor];
+        if (!region->id) {
+            numa_cursor = (numa_cursor + 1) % NUMA_REGIONS;
+            visited++;
+            pthread_mutex_unlock(&numa_lock);
+            continue;
+        }
+        uint64_t id = region->id;
+        uint64_t generation = region->generation;
+        size_t region_pages = (region->length + page_size - 1) / page_size;
+        size_t stride = region_pages > NUMA_SAMPLES_PER_REGION ? region_pages / NUMA_SAMPLES_PER_REGION : 1;
+        size_t samples = (region_pages + stride - 1) / stride;
+        size_t first = region->cursor;
+        size_t count = samples - first;
+        if (count > NUMA_QUERY_CHUNK) count = NUMA_QUERY_CHUNK;
+        if (count > budget - (size_t)queried) count = budget - (size_t)queried;
+        uintptr_t base = region->start & ~(uintptr_t)(page_size - 1);
+        for (size_t i = 0; i < count; i++) {
+            pages[i] = (void *)(base + (first + i) * stride * page_size);
+        }
+        pthread_mutex_unlock(&numa_lock);
+
+        if (syscall(SYS_move_pages, 0, count, pages, NULL, status, 0) == -1) {
+            return -1;
+        }
+        queried += count;
+
+        pthread_mutex_lock(&numa_lock);
+        if (region->id == id && region->generation == generation) {
+            for (size_t i = 0; i < count; i++) {
+                if (status[i] >= 0) {
+                    region->pass_pages[status[i] < NUMA_MAX_NODES ? status[i] : NUMA_MAX_NODES - 1]++;
+                } else if (status[i] != -EFAULT) {
+                    region->pass_absent++;
+                }
+            }
+            region->cursor += count;
+            if (region->cursor >= samples) {
+                memcpy(region->pages, region->pass_pages, sizeof(region->pages));
+                region->absent = region->pass_absent;
+                region->stride = stride;
+                region->sampled = 1;
+                memset(region->pass_pages, 0, sizeof(region->pass_pages));
+                region->pass_absent = 0;
+                region->cursor = 0;
+                numa_cursor = (numa_cursor + 1) % NUMA_REGIONS;
+                visited++;
+            }
+        }
+        pthread_mutex_unlock(&numa_lock);
+    }
+    return queried;
+}
+
+/**
+ * @brief Estimates the resident bytes of all sampled regions per node.
+ *
+ * @param bytes Receives the estimate for each of NUMA_MAX_NODES nodes.
+ */
+static void numa_node_bytes(size_t *bytes) {
+    size_t page_size = (size_t)getpagesize();
+    memset(bytes, 0, NUMA_MAX_NODES * sizeof(size_t));
+    pthread_mutex_lock(&numa_lock);
+    for (unsigned i = 0; i < NUMA_REGIONS; i++) {
+        if (!numa_regions[i].id || !numa_regions[i].sampled) continue;
+        for (int node = 0; node < NUMA_MAX_NODES; node++) {
+            bytes[node] += numa_regions[i].pages[node] * numa_regions[i].stride * page_size;
+        }
+    }
+    pthread_mutex_unlock(&numa_lock);
+}
+
+/**
+ * @brief Body of the sampling thread: spends the page budget every numa_interval_ms.
+ *
+ * @param arg Unused.
+ * @return Always NULL.
+ */
+static void *numa_thread_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&numa_wait_lock);
+    while (!numa_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += numa_interval_ms / 1000;
+        deadline.tv_nsec += (numa_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (!numa_stop && pthread_cond_timedwait(&numa_cond, &numa_wait_lock, &deadline) != ETIMEDOUT);
+        if (numa_stop) break;
+        pthread_mutex_unlock(&numa_wait_lock);
+        if (numa_tick(numa_budget) == -1) {
+            safe_log("[numa] move_pages is not available, placement sampling stopped\n");
+            pthread_mutex_lock(&numa_wait_lock);
+            break;
+        }
+        pthread_mutex_lock(&numa_wait_lock);
+    }
+    pthread_mutex_unlock(&numa_wait_lock);
+    return NULL;
+}
+
+/**
+ * @brief Enables placement sampling and starts its thread if MEMORY_MONITOR_NUMA is set.
+ *
+ * The number of nodes comes from get_mempolicy(MPOL_F_MEMS_ALLOWED), so
+ * neither libnuma nor sysfs is needed.
+ */
+static void numa_start() {
+    if (!env_number("MEMORY_MONITOR_NUMA", 0)) return;
+
+    numa_min_bytes = env_number("MEMORY_MONITOR_NUMA_MIN_BYTES", 1 << 20);
+    if (numa_min_bytes == 0) numa_min_bytes = 1;
+    numa_budget = env_number("MEMORY_MONITOR_NUMA_PAGES", 1024);
+    if (numa_budget == 0) numa_budget = 1024;
+    numa_interval_ms = env_number("MEMORY_MONITOR_NUMA_INTERVAL_MS", 1000);
+    if (numa_interval_ms <= 0) numa_interval_ms = 1000;
+
+    unsigned long mask[1024 / (8 * sizeof(unsigned long))] = { 0 };
+    if (syscall(SYS_get_mempolicy, NULL, mask, 1024, NULL, MPOL_F_MEMS_ALLOWED) == 0) {
+        numa_nodes = 0;
+        for (size_t i = 0; i < sizeof(mask) / sizeof(mask[0]); i++) {
+            numa_nodes += __builtin_popcountl(mask[i]);
+        }
+    }
+
+    numa_enabled = 1;
+    numa_pid = getpid();
+    if (start_background_thread(&numa_thread, numa_thread_main) != 0) {
+        safe_log("[numa] cannot start sampling thread, placement is sampled at exit only\n");
+        numa_stop = 1;
+    }
+    safe_log("[numa] sampling %zu pages every %ld ms of blocks and mappings of at least %zu bytes on %d node(s)\n",
+             numa_budget, numa_interval_ms, numa_min_bytes, numa_nodes);
+}
+
+/**
+ * @brief Stops the sampling thread, samples regions without a completed pass and logs the placement report.
+ *
+ * The report lists the largest regions with their bytes per node next to
+ * the node the allocating thread ran on. A region with more than half of
+ * its resident pages on other nodes is flagged as remote-heavy.
+ */
+static void numa_finish() {
+    if (!numa_enabled || numa_pid != getpid()) return;
+
+    pthread_mutex_lock(&numa_wait_lock);
+    int started = !numa_stop;
+    numa_stop = 1;
+    pthread_cond_signal(&numa_cond);
+    pthread_mutex_unlock(&numa_wait_lock);
+    if (started) {
+        pthread_join(numa_thread, NULL);
+    }
+
+    size_t page_size = (size_t)getpagesize();
+    for (unsigned round = 0; round < NUMA_REGIONS * NUMA_SAMPLES_PER_REGION / NUMA_QUERY_CHUNK; round++) {
+        int pending = 0;
+        pthread_mutex_lock(&numa_lock);
+        for (unsigned i = 0; i < NUMA_REGIONS && !pending; i++) {
+            pending = numa_regions[i].id && !numa_regions[i].sampled;
+        }
+        pthread_mutex_unlock(&numa_lock);
+        if (!pending || numa_tick(numa_budget) <= 0) break;
+    }
+
+    size_t bytes[NUMA_MAX_NODES];
+    numa_node_bytes(bytes);
+    safe_log("[numa] placement of regions of at least %zu bytes on %d node(s)\n", numa_min_bytes, numa_nodes);
+    if (numa_dropped) {
+        safe_log("[numa] %llu regions were not sampled because the region table was full\n", (unsigned long long)numa_dropped);
+    }
+    for (int node = 0; node < NUMA_MAX_NODES; node++) {
+        if (bytes[node]) safe_log("[numa] node %d: ~%zu resident bytes in sampled regions\n", node, bytes[node]);
+    }
+
+    NumaRegion top[NUMA_REPORT_REGIONS];
+    unsigned count = 0;
+    pthread_mutex_lock(&numa_lock);
+    for (unsigned i = 0; i < NUMA_REGIONS; i++) {
+        if (!numa_regions[i].id || !numa_regions[i].sampled) continue;
+        unsigned pos = count < NUMA_REPORT_REGIONS ? count++ : NUMA_REPORT_REGIONS;
+        while (pos > 0 && top[pos - 1].length < numa_regions[i].length) {
+            if (pos < NUMA_REPORT_REGIONS) top[pos] = top[pos - 1];
+            pos--;
+        }
+        if (pos < NUMA_REPORT_REGIONS) top[pos] = numa_regions[i];
+    }
+    pthread_mutex_unlock(&numa_lock);
+
+    for (unsigned i = 0; i < count; i++) {
+        char nodes[256];
+        size_t used = 0;
+        uint64_t resident = 0;
+        uint64_t remote = 0;
+        nodes[0] = '\0';
+        for (int node = 0; node < NUMA_MAX_NODES; node++) {
+            if (!top[i].pages[node]) continue;
+            resident += top[i].pages[node];
+            if (node != top[i].cpu_node) remote += top[i].pages[node];
+            if (used < sizeof(nodes)) {
+                used += snprintf(nodes + used, sizeof(nodes) - used, " node%d=%zu", node,
+                                 (size_t)(top[i].pages[node] * top[i].stride * page_size));
+            }
+        }
+        safe_log("[numa] %s %p length=%zu tid=%d cpu_node=%d |%s not_present=%zu%s\n",
+                 top[i].kind == NUMA_KIND_MALLOC ? "malloc" : "mmap", (void *)top[i].start, top[i].length,
+                 (int)top[i].tid, top[i].cpu_node, resident ? nodes : " no resident pages",
+                 (size_t)(top[i].absent * top[i].stride * page_size),
+                 remote * 2 > resident ? " | remote-heavy" : "");
+    }
+}
+
+/**
+ * @brief Appends formatted text to a metrics response, truncating on overflow.
+ *
+ * @param conn Connection whose response is being rendered.
+ * @param format Format string (printf-style).
+ * @param ... Additional arguments.
+ */
+static void metrics_append(MetricsConnection *conn, const char *format, ...) {
+    size_t space = sizeof(conn->response) - conn->length;
+    va_list args;
+
+    if (space <= 1) return;
+    va_start(args, format);
+    int written = vsnprintf(conn->response + conn->length, space, format, args);
+    va_end(args);
+    if (written < 0) return;
+    conn->length += (size_t)written < space ? (size_t)written : space - 1;
+}
+
+/**
+ * @brief Renders the Prometheus text exposition into a connection's response.
+ *
+ * alloc_lock is held only while the counters and the sites table are copied;
+ * selecting the top sites and formatting happen on the copies.
+ *
+ * @param conn Connection to render the response for.
+ * @param http Whether to prepend an HTTP/1.0 response header.
+ */
+static void metrics_render(MetricsConnection *conn, int http) {
+    MemoryStats stats;
+    Site top[METRICS_TOP_SITES];
+    unsigned top_count = 0;
+    ThreadStats threads[THREAD_SLOTS];
+    ThreadPair pairs[METRICS_TOP_SITES];
+    unsigned thread_count = atomic_load_explicit(&thread_slots_used, memory_order_relaxed);
+
+    collect_stats(&stats);
+    pthread_mutex_lock(&alloc_lock);
+    memcpy(metrics_sites, sites, sizeof(sites));
+    memcpy(threads, thread_stats, thread_count * sizeof(ThreadStats));
+    pthread_mutex_unlock(&alloc_lock);
+    unsigned pair_count = top_thread_pairs(pairs, METRICS_TOP_SITES, thread_count);
+
+    for (unsigned i = 0; i < SITE_TABLE_SIZE; i++) {
+        if (!metrics_sites[i].addr || metrics_sites[i].live_bytes == 0) continue;
+        unsigned pos = top_count < METRICS_TOP_SITES ? top_count++ : METRICS_TOP_SITES;
+        while (pos > 0 && top[pos - 1].live_bytes < metrics_sites[i].live_bytes) {
+            if (pos < METRICS_TOP_SITES) top[pos] = top[pos - 1];
+            pos--;
+        }
+        if (pos < METRICS_TOP_SITES) top[pos] = metrics_sites[i];
+    }
+
+    conn->length = 0;
+    conn->sent = 0;
+    if (http) {
+        metrics_append(conn, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n");
+    }
+    metrics_append(conn, "# HELP memory_monitor_live_bytes Live bytes by allocation kind.\n"
+                         "# TYPE memory_monitor_live_bytes gauge\n"
+                         "memory_monitor_live_bytes{kind=\"malloc\"} %zu\n"
+                         "memory_monitor_live_bytes{kind=\"mmap\"} %zu\n",
+                   stats.malloc_bytes, stats.mmap_bytes);
+    metrics_append(conn, "# HELP memory_monitor_peak_bytes Highest malloc + mmap total.\n"
+                         "# TYPE memory_monitor_peak_bytes gauge\n"
+                         "memory_monitor_peak_bytes %zu\n", stats.peak_bytes);
+    metrics_append(conn, "# HELP memory_monitor_kind_peak_bytes Highest live bytes per allocation kind.\n"
+                         "# TYPE memory_monitor_kind_peak_bytes gauge\n"
+                         "memory_monitor_kind_peak_bytes{kind=\"malloc\"} %zu\n"
+                         "memory_monitor_kind_peak_bytes{kind=\"mmap\"} %zu\n",
+                   stats.peak_malloc_bytes, stats.peak_mmap_bytes);
+    metrics_append(conn, "# HELP memory_monitor_operations_total Intercepted operations by type.\n"
+                         "# TYPE memory_monitor_operations_total counter\n"
+                         "memory_monitor_operations_total{op=\"malloc\"} %llu\n"
+                         "memory_monitor_operations_total{op=\"realloc\"} %llu\n"
+                         "memory_monitor_operations_total{op=\"free\"} %llu\n"
+                         "memory_monitor_operations_total{op=\"mmap\"} %llu\n"
+                         "memory_monitor_operations_total{op=\"munmap\"} %llu\n",
+                   (unsigned long long)stats.malloc_calls, (unsigned long long)stats.realloc_calls,
+                   (unsigned long long)stats.free_calls,
+                   (unsigned long long)stats.mmap_calls, (unsigned long long)stats.munmap_calls);
+    metrics_append(conn, "# HELP memory_monitor_bad_frees_total Detected double frees and frees of untracked pointers.\n"
+                         "# TYPE memory_monitor_bad_frees_total counter\n"
+                         "memory_monitor_bad_frees_total{kind=\"double\"} %llu\n"
+                         "memory_monitor_bad_frees_total{kind=\"invalid\"} %llu\n",
+                   (unsigned long long)stats.double_frees, (unsigned long long)stats.invalid_frees);
+    metrics_append(conn, "# HELP memory_monitor_pending_frees Deferred frees not yet reconciled (their blocks still count as live).\n"
+                         "# TYPE memory_monitor_pending_frees gauge\n"
+                         "memory_monitor_pending_frees %llu\n", (unsigned long long)stats.pending_frees);
+    metrics_append(conn, "# HELP memory_monitor_live_block_size_bytes Sizes of live malloc blocks.\n"
+                         "# TYPE memory_monitor_live_block_size_bytes histogram\n");
+    uint64_t cumulative = 0;
+    for (int i = 0; i < MM_HIST_BUCKETS - 1; i++) {
+        cumulative += stats.histogram[i];
+        metrics_append(conn, "memory_monitor_live_block_size_bytes_bucket{le=\"%llu\"} %llu\n",
+                       16ULL << i, (unsigned long long)cumulative);
+    }
+    metrics_append(conn, "memory_monitor_live_block_size_bytes_bucket{le=\"+Inf\"} %llu\n"
+                         "memory_monitor_live_block_size_bytes_sum %zu\n"
+                         "memory_monitor_live_block_size_bytes_count %llu\n",
+                   (unsigned long long)stats.live_blocks, stats.malloc_bytes,
+                   (unsigned long long)stats.live_blocks);
+    metrics_append(conn, "# HELP memory_monitor_site_live_bytes Live bytes of the top allocation sites.\n"
+                         "# TYPE memory_monitor_site_live_bytes gauge\n");
+    for (unsigned i = 0; i < top_count; i++) {
+        metrics_append(conn, "memory_monitor_site_live_bytes{site=\"%p\"} %zu\n", top[i].addr, top[i].live_bytes);
+    }
+    metrics_append(conn, "# HELP memory_monitor_site_allocations_total Allocations made by the top allocation sites.\n"
+                         "# TYPE memory_monitor_site_allocations_total counter\n");
+    for (unsigned i = 0; i < top_count; i++) {
+        metrics_append(conn, "memory_monitor_site_allocations_total{site=\"%p\"} %llu\n",
+                       top[i].addr, (unsigned long long)top[i].allocations);
+    }
+    if (numa_enabled) {
+        size_t bytes[NUMA_MAX_NODES];
+        numa_node_bytes(bytes);
+        metrics_append(conn, "# HELP memory_monitor_numa_resident_bytes Estimated resident bytes of sampled large regions per NUMA node.\n"
+                             "# TYPE memory_monitor_numa_resident_bytes gauge\n");
+        for (int node = 0; node < NUMA_MAX_NODES && node < numa_nodes; node++) {
+            metrics_append(conn, "memory_monitor_numa_resident_bytes{node=\"%d\"} %zu\n", node, bytes[node]);
+        }
+    }
+    metrics_append(conn, "# HELP memory_monitor_thread_live_bytes Live bytes owned by each allocating thread.\n"
+                         "# TYPE memory_monitor_thread_live_bytes gauge\n");
+    for (unsigned i = 0; i < thread_count; i++) {
+        metrics_append(conn, "memory_monitor_thread_live_bytes{tid=\"%d\"} %zu\n", (int)threads[i].tid, threads[i].live_bytes);
+    }
+    metrics_append(conn, "# HELP memory_monitor_thread_allocations_total Blocks created by each thread.\n"
+                         "# TYPE memory_monitor_thread_allocations_total counter\n");
+    for (unsigned i = 0; i < thread_count; i++) {
+        metrics_append(conn, "memory_monitor_thread_allocations_total{tid=\"%d\"} %llu\n",
+                       (int)threads[i].tid, (unsigned long long)threads[i].allocations);
+    }
+    metrics_append(conn, "# HELP memory_monitor_cross_thread_frees_total Blocks freed by a different thread than the one that allocated them.\n"
+                         "# TYPE memory_monitor_cross_thread_frees_total counter\n");
+    for (unsigned i = 0; i < pair_count; i++) {
+        metrics_append(conn, "memory_monitor_cross_thread_frees_total{producer=\"%d\",consumer=\"%d\"} %llu\n",
+                       (int)threads[pairs[i].producer].tid, (int)threads[pairs[i].consumer].tid,
+                       (unsigned long long)pairs[i].frees);
+    }
+}
+
+/**
+ * @brief Closes a metrics client connection and frees its slot.
+ *
+ * @param conn The connection to close.
+ */
+static void metrics_close(MetricsConnection *conn) {
+    epoll_ctl(metrics_epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn->fd = -1;
+}
+
+/**
+ * @brief Sends the pending part of a response; closes the connection when done.
+ *
+ * @param conn The connection to write to.
+ */
+static void metrics_flush(MetricsConnection *conn) {
+    while (conn->sent < conn->length) {
+        ssize_t n = send(conn->fd, conn->response + conn->sent, conn->length - conn->sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            conn->sent += (size_t)n;
+        } else if (n == -1 && errno == EINTR) {
+            continue;
+        } else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct epoll_event event = { .events = EPOLLOUT, .data.u32 = (uint32_t)(conn - metrics_connections) };
+            epoll_ctl(metrics_epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+            return;
+        } else {
+            break;
+        }
+    }
+    metrics_close(conn);
+}
+
+/**
+ * @brief Reads a client request and answers it once its first line has arrived.
+ *
+ * A request starting with "GET " is answered with an HTTP/1.0 response,
+ * anything else (e.g. "metrics\n") with the bare text exposition.
+ *
+ * @param conn The connection that became readable.
+ */
+static void metrics_read(MetricsConnection *conn) {
+    size_t space = sizeof(conn->request) - conn->request_length;
+    ssize_t n = recv(conn->fd, conn->request + conn->request_length, space, 0);
+    if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+    if (n <= 0 && conn->request_length == 0) {
+        metrics_close(conn);
+        return;
+    }
+    if (n > 0) conn->request_length += (size_t)n;
+    if (n > 0 && conn->request_length < sizeof(conn->request) &&
+        !memchr(conn->request, '\n', conn->request_length)) {
+        return;
+    }
+    metrics_render(conn, conn->request_length >= 4 && memcmp(conn->request, "GET ", 4) == 0);
+    metrics_flush(conn);
+}
+
+/**
+ * @brief Accepts all pending clients of the metrics socket.
+ */
+static void metrics_accept() {
+    for (;;) {
+        int fd = accept4(metrics_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) return;
+
+        MetricsConnection *conn = NULL;
+        for (int i = 0; i < METRICS_MAX_CONNECTIONS; i++) {
+            if (metrics_connections[i].fd == -1) {
+                conn = &metrics_connections[i];
+                break;
+            }
+        }
+        if (!conn) {
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        conn->request_length = 0;
+        struct epoll_event event = { .events = EPOLLIN, .data.u32 = (uint32_t)(conn - metrics_connections) };
+        if (epoll_ctl(metrics_epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+            close(fd);
+            conn->fd = -1;
+        }
+    }
+}
+
+/**
+ * @brief Body of the metrics thread: an epoll loop over the socket and its clients.
+ *
+ * @param arg Unused.
+ * @return Always NULL.
+ */
+static void *metrics_thread_main(void *arg) {
+    struct epoll_event events[METRICS_MAX_CONNECTIONS + 2];
+    (void)arg;
+
+    for (;;) {
+        int count = epoll_wait(metrics_epoll_fd, events, METRICS_MAX_CONNECTIONS + 2, -1);
+        if (count == -1 && errno == EINTR) continue;
+        if (count == -1) break;
+        for (int i = 0; i < count; i++) {
+            uint32_t id = events[i].data.u32;
+            if (id == METRICS_MAX_CONNECTIONS + 1) return NULL;
+            if (id == METRICS_MAX_CONNECTIONS) {
+                metrics_accept();
+                continue;
+            }
+            MetricsConnection *conn = &metrics_connections[id];
+            if (conn->fd == -1) continue;
+            if (events[i].events & EPOLLOUT) {
+                metrics_flush(conn);
+            } else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                metrics_read(conn);
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Opens the metrics socket and starts the metrics thread if MEMORY_MONITOR_METRICS_SOCKET is set.
+ *
+ * Every "%p" in the socket path is replaced with the process ID (see
+ * expand_pid_path()).
+ */
+static void metrics_start() {
+    const char *path = getenv("MEMORY_MONITOR_METRICS_SOCKET");
+    if (!path || !*path) return;
+
+    size_t length = expand_pid_path(path, metrics_path, sizeof(metrics_path));
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    memcpy(addr.sun_path, metrics_path, length + 1);
+    metrics_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (metrics_fd == -1) {
+        safe_log("[metrics] cannot create socket\n");
+        return;
+    }
+    unlink(metrics_path);
+    if (bind(metrics_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(metrics_fd, 64) == -1) {
+        safe_log("[metrics] cannot listen on %s\n", metrics_path);
+        close(metrics_fd);
+        metrics_fd = -1;
+        return;
+    }
+
+    for (int i = 0; i < METRICS_MAX_CONNECTIONS; i++) {
+        metrics_connections[i].fd = -1;
+    }
+    metrics_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    metrics_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event listen_event = { .events = EPOLLIN, .data.u32 = METRICS_MAX_CONNECTIONS };
+    struct epoll_event wake_event = { .events = EPOLLIN, .data.u32 = METRICS_MAX_CONNECTIONS + 1 };
+    if (metrics_epoll_fd == -1 || metrics_wake_fd == -1 ||
+        epoll_ctl(metrics_epoll_fd, EPOLL_CTL_ADD, metrics_fd, &listen_event) == -1 ||
+        epoll_ctl(metrics_epoll_fd, EPOLL_CTL_ADD, metrics_wake_fd, &wake_event) == -1 ||
+        start_background_thread(&metrics_thread, metrics_thread_main) != 0) {
+        safe_log("[metrics] cannot start metrics thread\n");
+        if (metrics_epoll_fd != -1) close(metrics_epoll_fd);
+        if (metrics_wake_fd != -1) close(metrics_wake_fd);
+        close(metrics_fd);
+        unlink(metrics_path);
+        metrics_fd = -1;
+        return;
+    }
+    metrics_pid = getpid();
+    safe_log("[metrics] serving metrics on %s\n", metrics_path);
+}
+
+/**
+ * @brief Stops the metrics thread and removes the metrics socket.
+ */
+static void metrics_finish() {
+    if (metrics_fd == -1 || metrics_pid != getpid()) return;
+
+    uint64_t one = 1;
+    if (write(metrics_wake_fd, &one, sizeof(one)) == sizeof(one)) {
+        pthread_join(metrics_thread, NULL);
+    }
+    for (int i = 0; i < METRICS_MAX_CONNECTIONS; i++) {
+        if (metrics_connections[i].fd != -1) close(metrics_connections[i].fd);
+    }
+    close(metrics_epoll_fd);
+    close(metrics_wake_fd);
+    close(metrics_fd);
+    unlink(metrics_path);
+    metrics_fd = -1;
+}
+
+/**
+ * @brief Enables self-overhead measurement if MEMORY_MONITOR_OVERHEAD is set.
+ *
+ * The PMU is probed once from the initializing thread; if the counters
+ * cannot be opened or read with rdpmc, all threads use CLOCK_MONOTONIC
+ * timestamps instead, so the units never mix.
+ */
+static void overhead_start() {
+    OverheadThread probe = { 0 };
+    if (!env_number("MEMORY_MONITOR_OVERHEAD", 0)) return;
+    if (pthread_key_create(&overhead_key, overhead_thread_exit) != 0) return;
+    pthread_atfork(NULL, NULL, overhead_after_fork);
+
+    if (overhead_open(&probe) == 0) {
+        overhead_close(&probe);
+        overhead_mode = MM_OVERHEAD_CYCLES;
+        safe_log("[overhead] measuring the library with perf_event counters\n");
+    } else {
+        snprintf(overhead_fallback_reason, sizeof(overhead_fallback_reason), "perf_event_open/rdpmc: %s", strerror(errno));
+        overhead_mode = MM_OVERHEAD_NS;
+        safe_log("[overhead] PMU counters unavailable (%s), measuring with timestamps\n", overhead_fallback_reason);
+    }
+}
+
+/**
+ * @brief Serves an allocation from the bootstrap arena.
+ *
+ * Used only by the thread resolving the original functions (dlsym may
+ * allocate). The arena is a lock-free bump allocator; blocks are never
+ * reused, and free() ignores them.
+ *
+ * @param size The number of bytes to allocate.
+ * @param alignment Alignment of the block (a power of two).
+ * @return The zero-filled block, or NULL when the arena is exhausted.
+ */
+static void *bootstrap_alloc(size_t size, size_t alignment) {
+    size_t used = atomic_load_explicit(&bootstrap_used, memory_order_relaxed);
+    size_t start;
+    if (alignment < 16) alignment = 16;
+    do {
+        start = (used + sizeof(size_t) + alignment - 1) & ~(alignment - 1);
+        if (size > BOOTSTRAP_ARENA_SIZE || start + size > BOOTSTRAP_ARENA_SIZE) {
+            errno = ENOMEM;
+            return NULL;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&bootstrap_used, &used, start + size,
+                                                    memory_order_relaxed, memory_order_relaxed));
+    memcpy(&bootstrap_arena[start - sizeof(size_t)], &size, sizeof(size));
+    return &bootstrap_arena[start];
+}
+
+/**
+ * @brief Checks whether a block was served from the bootstrap arena.
+ *
+ * @param ptr Pointer to check.
+ * @return 1 if @p ptr is in bootstrap_arena.
+ */
+static inline int bootstrap_owns(const void *ptr) {
+    return (const char *)ptr >= bootstrap_arena && (const char *)ptr < bootstrap_arena + BOOTSTRAP_ARENA_SIZE;
+}
+
+/**
+ * @brief Returns the size stored in front of a bootstrap block.
+ *
+ * @param ptr Block of the bootstrap arena.
+ * @return The requested size of the block.
+ */
+static inline size_t bootstrap_block_size(const void *ptr) {
+    size_t size;
+    memcpy(&size, (const char *)ptr - sizeof(size_t), sizeof(size));
+    return size;
+}
+
+/**
+ * @brief Moves a bootstrap block to a block of the given size.
+ *
+ * Like realloc(ptr, 0), a size of 0 frees the block, which for a bootstrap
+ * block is a no-op, and returns NULL. The new block comes from the arena
+ * while the original functions are being resolved and from real_malloc
+ * otherwise; it is tracked like a malloc unless the library itself is
+ * allocating (monitor_busy).
+ *
+ * @param ptr Block of the bootstrap arena.
+ * @param size The new size of the block, in bytes.
+ * @param caller Return address of the realloc call.
+ * @return The new block, or NULL on failure or when @p size is 0.
+ */
+static void *bootstrap_realloc(void *ptr, size_t size, void *caller) {
+    size_t old_size = bootstrap_block_size(ptr);
+    if (size == 0) return NULL;
+    void *new_ptr = init_resolving ? bootstrap_alloc(size, 16) : real_malloc(size);
+    if (!new_ptr) return NULL;
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    if (!init_resolving && !monitor_busy) track_allocation(new_ptr, size, caller);
+    return new_ptr;
+}
+
+/**
+ * @brief Resolves the original functions. Called once, by ensure_init().
+ */
+static void resolve_symbols() {
+    real_malloc   = dlsym(RTLD_NEXT, "malloc");
+    real_free     = dlsym(RTLD_NEXT, "free");
+    real_calloc   = dlsym(RTLD_NEXT, "calloc");
+    real_realloc  = dlsym(RTLD_NEXT, "realloc");
+    real_mmap     = dlsym(RTLD_NEXT, "mmap");
+    real_mmap64   = dlsym(RTLD_NEXT, "mmap64");
+    real_munmap   = dlsym(RTLD_NEXT, "munmap");
+    real_munmap64 = dlsym(RTLD_NEXT, "munmap64");
+    real_sbrk     = dlsym(RTLD_NEXT, "sbrk");
+    real_dlopen   = dlsym(RTLD_NEXT, "dlopen");
+    real_dlclose   = dlsym(RTLD_NEXT, "dlclose");
+    real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+    real_aligned_alloc  = dlsym(RTLD_NEXT, "aligned_alloc");
+    real_memalign = dlsym(RTLD_NEXT, "memalign");
+    real_valloc   = dlsym(RTLD_NEXT, "valloc");
+    real_pvalloc  = dlsym(RTLD_NEXT, "pvalloc");
+    real_mremap   = dlsym(RTLD_NEXT, "mremap");
+    real_brk      = dlsym(RTLD_NEXT, "brk");
+    real_malloc_usable_size = dlsym(RTLD_NEXT, "malloc_usable_size");
 }
 
 /**
- * @brief Adds a new allocation entry to the Allocation list.
+ * @brief Resolves the original functions if no thread has done it yet.
  *
- * @param ptr Pointer returned by the memory allocation function (malloc/calloc/realloc).
- * @param size The size of the allocated memory in bytes.
+ * The first thread to get here resolves them; allocations it makes from
+ * dlsym are served from bootstrap_arena. Other threads arriving during the
+ * resolution wait for it (this can only happen before the constructor has
+ * finished). Afterwards this is a single acquire load.
  */
-static void add_allocation(void *ptr, size_t size) {
-    Allocation *new_alloc = real_malloc(sizeof(Allocation));
-    if (!new_alloc) return;
-    new_alloc->ptr = ptr;
-    new_alloc->size = size;
-    pthread_mutex_lock(&alloc_lock);
-    new_alloc->next = allocations_head;
-    allocations_head = new_alloc;
-    total_malloc_alloc += size;
-    pthread_mutex_unlock(&alloc_lock);
+static void ensure_init_slow() {
+    int expected = INIT_NONE;
+    if (init_resolving) return;
+    init_resolving = 1;
+    if (atomic_compare_exchange_strong_explicit(&init_state, &expected, INIT_RESOLVING,
+                                                memory_order_acq_rel, memory_order_acquire)) {
+        resolve_symbols();
+        atomic_store_explicit(&init_state, INIT_DONE, memory_order_release);
+    } else {
+        while (atomic_load_explicit(&init_state, memory_order_acquire) != INIT_DONE) sched_yield();
+    }
+    init_resolving = 0;
 }
 
 /**
- * @brief Removes an allocation entry from the list when the memory is freed.
+ * @brief Makes sure the original functions are resolved. Called first by every interposer.
  *
- * @param ptr Pointer to the memory block that is being freed.
+ * Interposers may run before init_library(), e.g. from the constructors of
+ * libraries initialized earlier, so the symbols are resolved lazily.
  */
-static void remove_allocation(void *ptr) {
-    pthread_mutex_lock(&alloc_lock);
-    Allocation *current = allocations_head;
-    Allocation *prev = NULL;
-    while (current) {
-        if (current->ptr == ptr) {
-            if (prev) {
-                prev->next = current->next;
-            } else {
-                allocations_head = current->next;
-            }
-            total_malloc_alloc -= current->size;
-            real_free(current);
-            break;
-        }
-        prev = current;
-        current = current->next;
+static inline void ensure_init() {
+    if (__builtin_expect(atomic_load_explicit(&init_state, memory_order_acquire) != INIT_DONE, 0)) {
+        ensure_init_slow();
     }
-    pthread_mutex_unlock(&alloc_lock);
 }
 
 /**
  * @brief Library initialization function (automatically called upon loading).
  *
- * Initializes pointers to the original implementations of functions
- * (malloc, free, mmap, etc.) and logs the initial state of the library.
+ * Resolves the original implementations of functions (malloc, free,
+ * mmap, etc.) unless an earlier interposed call already did, reads the
+ * configuration, starts the optional features and logs the initial state
+ * of the library. Allocations made by the library itself while doing so
+ * are not tracked.
  */
 __attribute__((constructor))
 static void init_library() {
     safe_log("Initializing memory_monitor library.\n");
-    real_malloc   = dlsym(RTLD_NEXT, "malloc");
-    real_free     = dlsym(RTLD_NEXT, "free");
-    real_calloc   = dlsym(RTLD_NEXT, "calloc");
-    real_realloc  = dlsym(RTLD_NEXT, "realloc");
-    real_mmap     = dlsym(RTLD_NEXT, "mmap");
-    real_mmap64   = dlsym(RTLD_NEXT, "mmap64");
-    real_munmap   = dlsym(RTLD_NEXT, "munmap");
-    real_munmap64 = dlsym(RTLD_NEXT, "munmap64");
-    real_sbrk     = dlsym(RTLD_NEXT, "sbrk");
-    real_dlopen   = dlsym(RTLD_NEXT, "dlopen");
-    real_dlclose   = dlsym(RTLD_NEXT, "dlclose");
+    ensure_init();
+    monitor_busy++;
+
+    const char *log_env = getenv("MEMORY_MONITOR_LOG");
+    if (log_env && strcmp(log_env, "0") == 0) {
+        log_operations = 0;
+    }
+    const char *bad_free_env = getenv("MEMORY_MONITOR_BAD_FREE");
+    bad_free_abort = bad_free_env && strcmp(bad_free_env, "abort") == 0;
+    if (env_number("MEMORY_MONITOR_FREE_STACKS", 0)) {
+        void *frames[1];
+        backtrace(frames, 1);
+        free_stacks = 1;
+    }
+    if (pthread_key_create(&thread_exit_key, thread_stats_exit) == 0) {
+        thread_exit_key_ready = 1;
+    }
+    if (env_number("MEMORY_MONITOR_DEFER_FREE", 0) &&
+        pthread_key_create(&free_batch_key, free_batch_thread_exit) == 0) {
+        pthread_atfork(NULL, NULL, free_batches_after_fork);
+        defer_frees = 1;
+    }
+    overhead_start();
+    filter_start();
+    guard_start();
+    numa_start();
+    ring_start();
+    metrics_start();
+    monitor_busy--;
 
     safe_log("Initialized memory_monitor library.\n");
     printUsage();
@@ -208,31 +4453,60 @@ static void init_library() {
 /**
  * @brief Library finalization function (automatically called upon unloading).
  *
- * Logs the final memory usage state before the library is unloaded.
+ * Writes the last snapshot record (if the ring file is enabled), reports
+ * the realloc sites that copied the most data and logs the final memory
+ * usage state before the library is unloaded.
  */
 __attribute__((destructor))
 static void fini_library() {
+    monitor_busy++;
+    metrics_finish();
+    ring_finish();
+    numa_finish();
+    report_realloc_sites();
+    report_threads();
+    report_peak();
+    report_overhead();
+    if (guard_allocations) {
+        safe_log("[guard] %llu allocations were served from the guarded pool\n", (unsigned long long)guard_allocations);
+    }
+    if (filters_enabled) {
+        safe_log("[filter] %llu allocations were not tracked\n", (unsigned long long)filtered_allocations);
+    }
+    if (bootstrap_used) {
+        safe_log("[bootstrap] %zu bytes were served before the original allocator was resolved\n", (size_t)bootstrap_used);
+    }
+    if (double_frees || invalid_frees) {
+        safe_log("[bad free] detected double_frees=%llu invalid_frees=%llu\n",
+                 (unsigned long long)double_frees, (unsigned long long)invalid_frees);
+    }
+    flush_free_batches();
     printUsage();
     safe_log("Final state - malloc_alloc=%zu bytes | mmap_alloc=%zu bytes | total_alloc=%zu bytes\n",
-             total_malloc_alloc, total_mmap_alloc - total_mmap_dealloc, total_malloc_alloc + (total_mmap_alloc - total_mmap_dealloc));
+             (size_t)total_malloc_alloc, total_mmap_alloc - total_mmap_dealloc, total_malloc_alloc + (total_mmap_alloc - total_mmap_dealloc));
+    monitor_busy--;
 }
 
 /**
  * @brief Utility function to report memory usage in KB, MB, and page counts.
  *
- * Logs the current usage of memory allocated by malloc/calloc/realloc and mmap.
+ * Logs the current usage of memory allocated by malloc/calloc/realloc and mmap
+ * together with the combined high-water mark. Deferred frees are not
+ * reconciled here, because this runs after every logged operation; the
+ * frees still buffered in the threads' batches are not reflected yet.
  */
 static void printUsage() {
     size_t current_mmap_alloc = total_mmap_alloc - total_mmap_dealloc;
     size_t total_alloc = total_malloc_alloc + current_mmap_alloc;
     int page_size = getpagesize();
-    safe_log("[usage] malloc_alloc=%zu bytes | ~%zu KB | ~%.2f MB | ~%zu pages | mmap_alloc=%zu bytes | total_alloc=%zu bytes\n",
-             total_malloc_alloc,
+    safe_log("[usage] malloc_alloc=%zu bytes | ~%zu KB | ~%.2f MB | ~%zu pages | mmap_alloc=%zu bytes | total_alloc=%zu bytes | peak=%zu bytes\n",
+             (size_t)total_malloc_alloc,
              total_malloc_alloc / 1024,
              (double)total_malloc_alloc / (1024.0 * 1024.0),
              total_alloc / page_size,
              current_mmap_alloc,
-             total_alloc
+             total_alloc,
+             (size_t)peak_total_alloc
     );
 }
 
@@ -243,27 +4517,89 @@ static void printUsage() {
  * @return A pointer to the allocated memory, or NULL on failure.
  */
 void *malloc(size_t size) {
-    void *ptr = real_malloc(size);
+    ensure_init();
+    if (init_resolving) return bootstrap_alloc(size, 16);
+    if (monitor_busy) return real_malloc(size);
+    overhead_enter();
+    void *ptr = guard_sample(size) ? guard_alloc(size, __builtin_return_address(0)) : NULL;
+    if (!ptr) {
+        overhead_real_begin();
+        ptr = real_malloc(size);
+        overhead_real_end();
+    }
     if (ptr) {
-        add_allocation(ptr, size);
-        safe_log("[malloc] size=%zu | ptr=%p\n", size, ptr);
-        printUsage();
+        track_allocation(ptr, size, __builtin_return_address(0));
+        op_log("[malloc] size=%zu | ptr=%p\n", size, ptr);
     }
+    overhead_leave(MM_OP_MALLOC);
     return ptr;
 }
 
+/**
+ * @brief Releases a block freed by the program.
+ *
+ * A pointer whose membership filter counter is zero is not tracked, which
+ * is decided without taking alloc_lock; such frees and frees missing from
+ * the allocation table are reported as double or invalid frees. A double
+ * free is not passed to real_free.
+ *
+ * With MEMORY_MONITOR_DEFER_FREE=1 the free is buffered in a thread-local
+ * batch and reconciled (and passed to real_free) together with others.
+ *
+ * @param ptr Pointer to the memory block to free.
+ * @param caller Return address of the free call.
+ * @param name Name of the intercepted function, for the operation log ("free" or "delete").
+ */
+static void release_block(void *ptr, void *caller, const char *name) {
+    if (!ptr) {
+        call_real_free(ptr);
+        return;
+    }
+    if (guard_owns(ptr)) {
+        remove_allocation(ptr, caller);
+        if (guard_release(ptr, caller) == 0) {
+            op_log("[%s] ptr=%p | guarded\n", name, ptr);
+        }
+        return;
+    }
+    if (!membership_maybe(ptr)) {
+        if (!report_bad_free(ptr, caller)) {
+            call_real_free(ptr);
+        }
+        return;
+    }
+    if (defer_frees && defer_free(ptr, caller)) {
+        op_log("[%s] ptr=%p | deferred\n", name, ptr);
+        return;
+    }
+    if (remove_allocation(ptr, caller)) {
+        op_log("[%s] ptr=%p\n", name, ptr);
+    } else if (report_bad_free(ptr, caller)) {
+        return;
+    }
+    call_real_free(ptr);
+}
+
 /**
  * @brief Intercepts calls to free in order to monitor memory deallocation.
  *
+ * While the original functions are being resolved, real_free may not be
+ * set yet; a block that is not from the bootstrap arena is then leaked
+ * rather than passed to it.
+ *
  * @param ptr Pointer to the memory block to free.
  */
 void free(void *ptr) {
-    if (ptr) {
-        remove_allocation(ptr);
-        safe_log("[free] ptr=%p\n", ptr);
-        printUsage();
+    if (bootstrap_owns(ptr)) return;
+    ensure_init();
+    if (init_resolving) return;
+    if (monitor_busy) {
+        real_free(ptr);
+        return;
     }
-    real_free(ptr);
+    overhead_enter();
+    release_block(ptr, __builtin_return_address(0), "free");
+    overhead_leave(MM_OP_FREE);
 }
 
 /**
@@ -274,35 +4610,295 @@ void free(void *ptr) {
  * @return A pointer to the allocated memory, or NULL on failure.
  */
 void *calloc(size_t nmemb, size_t size) {
-    void *ptr = real_calloc(nmemb, size);
+    size_t total;
+    ensure_init();
+    if (init_resolving) return __builtin_mul_overflow(nmemb, size, &total) ? NULL : bootstrap_alloc(total, 16);
+    if (monitor_busy) return real_calloc(nmemb, size);
+    overhead_enter();
+    void *ptr = !__builtin_mul_overflow(nmemb, size, &total) && guard_sample(total)
+                ? guard_alloc(total, __builtin_return_address(0)) : NULL;
+    if (!ptr) {
+        overhead_real_begin();
+        ptr = real_calloc(nmemb, size);
+        overhead_real_end();
+    }
     if (ptr) {
-        add_allocation(ptr, nmemb * size);
-        safe_log("[calloc] nmemb=%zu size=%zu | ptr=%p\n", nmemb, size, ptr);
-        printUsage();
+        track_allocation(ptr, nmemb * size, __builtin_return_address(0));
+        op_log("[calloc] nmemb=%zu size=%zu | ptr=%p\n", nmemb, size, ptr);
     }
+    overhead_leave(MM_OP_CALLOC);
     return ptr;
 }
 
 /**
- * @brief Intercepts calls to realloc in order to monitor memory reallocation.
+ * @brief Reallocates a block of the guarded pool.
+ *
+ * Guarded blocks cannot grow in place, so the data is always moved to a
+ * regular block and the slot is released (and quarantined).
+ *
+ * @param ptr Guarded block.
+ * @param size The new size of the block, in bytes.
+ * @param caller Return address of the realloc call.
+ * @return The new block, or NULL on failure or when @p size is 0.
+ */
+static void *guard_realloc(void *ptr, size_t size, void *caller) {
+    Allocation old;
+    int tracked = detach_allocation(ptr, &old, caller);
+    size_t old_size = guard_block_size(ptr);
+    void *new_ptr = NULL;
+    if (size) {
+        overhead_real_begin();
+        new_ptr = real_malloc(size);
+        overhead_real_end();
+    }
+    if (size && !new_ptr) {
+        if (tracked) restore_allocation(&old);
+        return NULL;
+    }
+    if (new_ptr && old_size) {
+        memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    }
+    if (guard_release(ptr, caller) == -1) {
+        return new_ptr;
+    }
+    if (new_ptr && tracked) {
+        resize_allocation(&old, new_ptr, size, caller);
+    } else if (new_ptr) {
+        track_allocation(new_ptr, size, caller);
+    } else if (tracked) {
+        unsigned consumer = current_thread_slot();
+        pthread_mutex_lock(&alloc_lock);
+        count_thread_free(consumer, old.thread);
+        free_calls++;
+        pthread_mutex_unlock(&alloc_lock);
+    }
+    op_log("[realloc] ptr=%p new_size=%zu | new_ptr=%p | guarded\n", ptr, size, new_ptr);
+    return new_ptr;
+}
+
+/**
+ * @brief Resizes a block for realloc and reallocarray.
+ *
+ * The tracked entry is detached, and its address remembered as freed,
+ * before the call, so the old address cannot be reused by another thread
+ * while it is still in the table or missing from freed_history. On
+ * failure the entry is restored unchanged; realloc(ptr, 0) counts as a free.
+ * A tracked block stays tracked; an untracked one is tracked from now on
+ * if the filters accept the new size and the realloc call site.
  *
  * @param ptr Pointer to the currently allocated memory block (may be NULL).
  * @param size The new size of the memory block, in bytes.
+ * @param caller Return address of the intercepted call.
  * @return A pointer to the allocated memory, or NULL on failure.
  */
-void *realloc(void *ptr, size_t size) {
-    if (ptr) {
-        remove_allocation(ptr);
+static void *resize_block(void *ptr, size_t size, void *caller) {
+    Allocation old;
+    if (ptr && guard_owns(ptr)) {
+        return guard_realloc(ptr, size, caller);
     }
+    int tracked = ptr && membership_maybe(ptr) ? detach_allocation(ptr, &old, caller) : 0;
+    overhead_real_begin();
     void *new_ptr = real_realloc(ptr, size);
+    overhead_real_end();
     if (new_ptr) {
-        add_allocation(new_ptr, size);
-        safe_log("[realloc] ptr=%p new_size=%zu | new_ptr=%p\n", ptr, size, new_ptr);
-        printUsage();
+        if (tracked) {
+            resize_allocation(&old, new_ptr, size, caller);
+        } else {
+            track_allocation(new_ptr, size, caller);
+        }
+        op_log("[realloc] ptr=%p new_size=%zu | new_ptr=%p | %s\n", ptr, size, new_ptr,
+               !tracked ? "new" : new_ptr == ptr ? "in-place" : "moved");
+    } else if (tracked && size != 0) {
+        restore_allocation(&old);
+    } else if (tracked) {
+        unsigned consumer = current_thread_slot();
+        pthread_mutex_lock(&alloc_lock);
+        count_thread_free(consumer, old.thread);
+        free_calls++;
+        pthread_mutex_unlock(&alloc_lock);
+    }
+    return new_ptr;
+}
+
+/**
+ * @brief Intercepts calls to realloc in order to monitor memory reallocation.
+ *
+ * @param ptr Pointer to the currently allocated memory block (may be NULL).
+ * @param size The new size of the memory block, in bytes.
+ * @return A pointer to the allocated memory, or NULL on failure.
+ */
+void *realloc(void *ptr, size_t size) {
+    ensure_init();
+    if (bootstrap_owns(ptr)) return bootstrap_realloc(ptr, size, __builtin_return_address(0));
+    if (init_resolving) return ptr ? NULL : bootstrap_alloc(size, 16);
+    if (monitor_busy) return real_realloc(ptr, size);
+    overhead_enter();
+    void *new_ptr = resize_block(ptr, size, __builtin_return_address(0));
+    overhead_leave(MM_OP_REALLOC);
+    return new_ptr;
+}
+
+/**
+ * @brief Intercepts calls to reallocarray in order to monitor memory reallocation.
+ *
+ * @param ptr Pointer to the currently allocated memory block (may be NULL).
+ * @param nmemb Number of elements.
+ * @param size Size of each element in bytes.
+ * @return A pointer to the allocated memory, or NULL on failure (ENOMEM if nmemb * size overflows).
+ */
+void *reallocarray(void *ptr, size_t nmemb, size_t size) {
+    size_t total;
+    if (__builtin_mul_overflow(nmemb, size, &total)) {
+        errno = ENOMEM;
+        return NULL;
     }
+    ensure_init();
+    if (bootstrap_owns(ptr)) return bootstrap_realloc(ptr, total, __builtin_return_address(0));
+    if (init_resolving) return ptr ? NULL : bootstrap_alloc(total, 16);
+    if (monitor_busy) return real_realloc(ptr, total);
+    overhead_enter();
+    void *new_ptr = resize_block(ptr, total, __builtin_return_address(0));
+    overhead_leave(MM_OP_REALLOC);
     return new_ptr;
 }
 
+/**
+ * @brief Tracks a block returned by one of the aligned allocation functions.
+ *
+ * @param name Name of the intercepted function (for the operation log).
+ * @param ptr The block (may be NULL).
+ * @param alignment Requested alignment.
+ * @param size Size of the block in bytes.
+ * @param caller Return address of the intercepted call.
+ */
+static void add_aligned_allocation(const char *name, void *ptr, size_t alignment, size_t size, void *caller) {
+    if (!ptr) return;
+    track_allocation(ptr, size, caller);
+    op_log("[%s] alignment=%zu size=%zu | ptr=%p\n", name, alignment, size, ptr);
+}
+
+/**
+ * @brief Intercepts calls to posix_memalign in order to monitor memory allocation.
+ *
+ * @param memptr Receives the allocated block.
+ * @param alignment Alignment (a power of two multiple of sizeof(void *)).
+ * @param size The number of bytes to allocate.
+ * @return 0 on success, or an error number.
+ */
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    ensure_init();
+    if (init_resolving) return (*memptr = bootstrap_alloc(size, alignment)) ? 0 : ENOMEM;
+    if (monitor_busy) return real_posix_memalign(memptr, alignment, size);
+    overhead_enter();
+    overhead_real_begin();
+    int ret = real_posix_memalign(memptr, alignment, size);
+    overhead_real_end();
+    if (ret == 0) add_aligned_allocation("posix_memalign", *memptr, alignment, size, __builtin_return_address(0));
+    overhead_leave(MM_OP_MALLOC);
+    return ret;
+}
+
+/**
+ * @brief Intercepts calls to aligned_alloc in order to monitor memory allocation.
+ *
+ * @param alignment Alignment of the block.
+ * @param size The number of bytes to allocate.
+ * @return A pointer to the allocated memory, or NULL on failure.
+ */
+void *aligned_alloc(size_t alignment, size_t size) {
+    ensure_init();
+    if (init_resolving) return bootstrap_alloc(size, alignment);
+    if (monitor_busy) return real_aligned_alloc(alignment, size);
+    overhead_enter();
+    overhead_real_begin();
+    void *ptr = real_aligned_alloc(alignment, size);
+    overhead_real_end();
+    add_aligned_allocation("aligned_alloc", ptr, alignment, size, __builtin_return_address(0));
+    overhead_leave(MM_OP_MALLOC);
+    return ptr;
+}
+
+/**
+ * @brief Intercepts calls to memalign in order to monitor memory allocation.
+ *
+ * @param alignment Alignment of the block.
+ * @param size The number of bytes to allocate.
+ * @return A pointer to the allocated memory, or NULL on failure.
+ */
+void *memalign(size_t alignment, size_t size) {
+    ensure_init();
+    if (init_resolving) return bootstrap_alloc(size, alignment);
+    if (monitor_busy) return real_memalign(alignment, size);
+    overhead_enter();
+    overhead_real_begin();
+    void *ptr = real_memalign(alignment, size);
+    overhead_real_end();
+    add_aligned_allocation("memalign", ptr, alignment, size, __builtin_return_address(0));
+    overhead_leave(MM_OP_MALLOC);
+    return ptr;
+}
+
+/**
+ * @brief Intercepts calls to valloc in order to monitor memory allocation.
+ *
+ * @param size The number of bytes to allocate.
+ * @return A page-aligned block, or NULL on failure.
+ */
+void *valloc(size_t size) {
+    ensure_init();
+    if (init_resolving) return bootstrap_alloc(size, (size_t)getpagesize());
+    if (monitor_busy) return real_valloc(size);
+    overhead_enter();
+    overhead_real_begin();
+    void *ptr = real_valloc(size);
+    overhead_real_end();
+    add_aligned_allocation("valloc", ptr, (size_t)getpagesize(), size, __builtin_return_address(0));
+    overhead_leave(MM_OP_MALLOC);
+    return ptr;
+}
+
+/**
+ * @brief Intercepts calls to pvalloc in order to monitor memory allocation.
+ *
+ * The block is accounted with its size rounded up to whole pages, which
+ * is what pvalloc allocates.
+ *
+ * @param size The number of bytes to allocate.
+ * @return A page-aligned block, or NULL on failure.
+ */
+void *pvalloc(size_t size) {
+    size_t page = (size_t)getpagesize();
+    ensure_init();
+    if (init_resolving) return bootstrap_alloc(size ? (size + page - 1) & ~(page - 1) : page, page);
+    if (monitor_busy) return real_pvalloc(size);
+    overhead_enter();
+    overhead_real_begin();
+    void *ptr = real_pvalloc(size);
+    overhead_real_end();
+    add_aligned_allocation("pvalloc", ptr, page, size ? (size + page - 1) & ~(page - 1) : page, __builtin_return_address(0));
+    overhead_leave(MM_OP_MALLOC);
+    return ptr;
+}
+
+/**
+ * @brief Intercepts calls to malloc_usable_size.
+ *
+ * Blocks of the guarded pool and of the bootstrap arena have no glibc
+ * chunk header in front of them (for a guarded block of exactly one page
+ * the header would lie in the PROT_NONE guard page), so their requested
+ * size is returned instead.
+ *
+ * @param ptr The block (may be NULL).
+ * @return Number of usable bytes in the block.
+ */
+size_t malloc_usable_size(void *ptr) {
+    if (bootstrap_owns(ptr)) return bootstrap_block_size(ptr);
+    ensure_init();
+    if (!ptr || init_resolving) return 0;
+    if (guard_owns(ptr)) return guard_block_size(ptr);
+    return real_malloc_usable_size(ptr);
+}
+
 /**
  * @brief Intercepts calls to mmap in order to track memory mapping.
  *
@@ -315,14 +4911,20 @@ void *realloc(void *ptr, size_t size) {
  * @return A pointer to the mapped area, or MAP_FAILED on failure.
  */
 void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    ensure_init();
+    if (init_resolving) return (void *)syscall(SYS_mmap, addr, length, prot, flags, fd, offset);
+    overhead_enter();
+    overhead_real_begin();
     void *res = real_mmap(addr, length, prot, flags, fd, offset);
+    overhead_real_end();
     if (res != MAP_FAILED) {
-        pthread_mutex_lock(&alloc_lock);
-        total_mmap_alloc += length;
-        pthread_mutex_unlock(&alloc_lock);
-        safe_log("[mmap] length=%zu fd=%d offset=%ld | res=%p\n", length, fd, offset, res);
-        printUsage();
+        atomic_fetch_add_explicit(&total_mmap_alloc, length, memory_order_relaxed);
+        atomic_fetch_add_explicit(&mmap_calls, 1, memory_order_relaxed);
+        grow_live(&live_mmap_bytes, &peak_mmap_bytes, length);
+        if (numa_enabled && length >= numa_min_bytes) numa_track(res, length, NUMA_KIND_MMAP);
+        op_log("[mmap] length=%zu fd=%d offset=%ld | res=%p\n", length, fd, offset, res);
     }
+    overhead_leave(MM_OP_MMAP);
     return res;
 }
 
@@ -338,14 +4940,20 @@ void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
  * @return A pointer to the mapped area, or MAP_FAILED on failure.
  */
 void *mmap64(void *addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    ensure_init();
+    if (init_resolving) return (void *)syscall(SYS_mmap, addr, length, prot, flags, fd, offset);
+    overhead_enter();
+    overhead_real_begin();
     void *res = real_mmap64(addr, length, prot, flags, fd, offset);
+    overhead_real_end();
     if (res != MAP_FAILED) {
-        pthread_mutex_lock(&alloc_lock);
-        total_mmap_alloc += length;
-        pthread_mutex_unlock(&alloc_lock);
-        safe_log("[mmap64] length=%zu fd=%d offset=%ld | res=%p\n", length, fd, offset, res);
-        printUsage();
+        atomic_fetch_add_explicit(&total_mmap_alloc, length, memory_order_relaxed);
+        atomic_fetch_add_explicit(&mmap_calls, 1, memory_order_relaxed);
+        grow_live(&live_mmap_bytes, &peak_mmap_bytes, length);
+        if (numa_enabled && length >= numa_min_bytes) numa_track(res, length, NUMA_KIND_MMAP);
+        op_log("[mmap64] length=%zu fd=%d offset=%ld | res=%p\n", length, fd, offset, res);
     }
+    overhead_leave(MM_OP_MMAP);
     return res;
 }
 
@@ -357,14 +4965,20 @@ void *mmap64(void *addr, size_t length, int prot, int flags, int fd, off_t offse
  * @return 0 on success, or -1 on error.
  */
 int munmap(void *addr, size_t length) {
+    ensure_init();
+    if (init_resolving) return (int)syscall(SYS_munmap, addr, length);
+    overhead_enter();
+    overhead_real_begin();
     int ret = real_munmap(addr, length);
+    overhead_real_end();
     if (ret == 0) {
-        pthread_mutex_lock(&alloc_lock);
-        total_mmap_dealloc += length;
-        pthread_mutex_unlock(&alloc_lock);
-        safe_log("[munmap] length=%zu | addr=%p\n", length, addr);
-        printUsage();
+        atomic_fetch_add_explicit(&total_mmap_dealloc, length, memory_order_relaxed);
+        atomic_fetch_add_explicit(&munmap_calls, 1, memory_order_relaxed);
+        shrink_live(&live_mmap_bytes, length, 0);
+        if (numa_enabled) numa_untrack(addr, length);
+        op_log("[munmap] length=%zu | addr=%p\n", length, addr);
     }
+    overhead_leave(MM_OP_MUNMAP);
     return ret;
 }
 
@@ -376,17 +4990,65 @@ int munmap(void *addr, size_t length) {
  * @return 0 on success, or -1 on error.
  */
 int munmap64(void *addr, size_t length) {
+    ensure_init();
+    if (init_resolving) return (int)syscall(SYS_munmap, addr, length);
+    overhead_enter();
+    overhead_real_begin();
     int ret = real_munmap64(addr, length);
+    overhead_real_end();
     if (ret == 0) {
-        pthread_mutex_lock(&alloc_lock);
-        total_mmap_dealloc += length;
-        pthread_mutex_unlock(&alloc_lock);
-        safe_log("[munmap64] length=%zu | addr=%p\n", length, addr);
-        printUsage();
+        atomic_fetch_add_explicit(&total_mmap_dealloc, length, memory_order_relaxed);
+        atomic_fetch_add_explicit(&munmap_calls, 1, memory_order_relaxed);
+        shrink_live(&live_mmap_bytes, length, 0);
+        if (numa_enabled) numa_untrack(addr, length);
+        op_log("[munmap64] length=%zu | addr=%p\n", length, addr);
     }
+    overhead_leave(MM_OP_MUNMAP);
     return ret;
 }
 
+/**
+ * @brief Intercepts calls to mremap in order to track resized and moved mappings.
+ *
+ * The old range is accounted as unmapped (unless MREMAP_DONTUNMAP keeps
+ * it) and the new range as mapped.
+ *
+ * @param old_address Start of the existing mapping.
+ * @param old_size Size of the existing mapping.
+ * @param new_size Requested size of the mapping.
+ * @param flags MREMAP_* flags.
+ * @return The address of the resized mapping, or MAP_FAILED on failure.
+ */
+void *mremap(void *old_address, size_t old_size, size_t new_size, int flags, ...) {
+    void *new_address = NULL;
+    if (flags & MREMAP_FIXED) {
+        va_list args;
+        va_start(args, flags);
+        new_address = va_arg(args, void *);
+        va_end(args);
+    }
+    ensure_init();
+    if (init_resolving) return (void *)syscall(SYS_mremap, old_address, old_size, new_size, flags, new_address);
+    overhead_enter();
+    overhead_real_begin();
+    void *res = real_mremap(old_address, old_size, new_size, flags, new_address);
+    overhead_real_end();
+    if (res != MAP_FAILED) {
+        if (!(flags & MREMAP_DONTUNMAP)) {
+            atomic_fetch_add_explicit(&total_mmap_dealloc, old_size, memory_order_relaxed);
+            shrink_live(&live_mmap_bytes, old_size, 0);
+            if (numa_enabled) numa_untrack(old_address, old_size);
+        }
+        atomic_fetch_add_explicit(&total_mmap_alloc, new_size, memory_order_relaxed);
+        grow_live(&live_mmap_bytes, &peak_mmap_bytes, new_size);
+        if (numa_enabled && new_size >= numa_min_bytes) numa_track(res, new_size, NUMA_KIND_MMAP);
+        op_log("[mremap] old_address=%p old_size=%zu new_size=%zu flags=%d | res=%p\n",
+               old_address, old_size, new_size, flags, res);
+    }
+    overhead_leave(MM_OP_MMAP);
+    return res;
+}
+
 /**
  * @brief Intercepts calls to sbrk to track changes to the data segment.
  *
@@ -394,12 +5056,25 @@ int munmap64(void *addr, size_t length) {
  * @return The new program break, or (void*) -1 on failure.
  */
 void *sbrk(intptr_t increment) {
+    ensure_init();
     void *res = real_sbrk(increment);
-    safe_log("[sbrk] increment=%ld | new_brk=%p\n", (long)increment, res);
-    printUsage();
+    op_log("[sbrk] increment=%ld | new_brk=%p\n", (long)increment, res);
     return res;
 }
 
+/**
+ * @brief Intercepts calls to brk to track changes to the data segment.
+ *
+ * @param addr The requested program break.
+ * @return 0 on success, or -1 on failure.
+ */
+int brk(void *addr) {
+    ensure_init();
+    int ret = real_brk(addr);
+    op_log("[brk] addr=%p | ret=%d\n", addr, ret);
+    return ret;
+}
+
 /**
  * @brief Intercepts calls to dlopen to monitor shared library loading.
  *
@@ -408,6 +5083,7 @@ void *sbrk(intptr_t increment) {
  * @return A handle to the library, or NULL on failure.
  */
 void *dlopen(const char *filename, int flag) {
+    ensure_init();
     void *handle = real_dlopen(filename, flag);
     if (handle) {
         safe_log("[dlopen] filename=%s | flag=%d | handle=%p\n", filename, flag, handle);
@@ -424,7 +5100,234 @@ void *dlopen(const char *filename, int flag) {
  * @return 0 on success, or another value on failure.
  */
 int dlclose(void *handle) {
+    ensure_init();
     int ret = real_dlclose(handle);
+    if (ret == 0) filter_cache_clear();
     safe_log("[dlclose] handle=%p | ret=%d\n", handle, ret);
     return ret;
+}
+
+/**
+ * @brief Returns the original C++ operator, resolving it on first use.
+ *
+ * @param op The operator (CXX_*).
+ * @return The original operator, or NULL if no loaded library defines it.
+ */
+static void *cxx_real(int op) {
+    void *fn = atomic_load_explicit(&real_cxx_operators[op], memory_order_relaxed);
+    if (!fn) {
+        monitor_busy++;
+        fn = dlsym(RTLD_NEXT, cxx_operator_names[op]);
+        monitor_busy--;
+        atomic_store_explicit(&real_cxx_operators[op], fn, memory_order_relaxed);
+    }
+    return fn;
+}
+
+/**
+ * @brief Calls an original operator new.
+ *
+ * @param op The operator (CXX_NEW*).
+ * @param size The number of bytes to allocate.
+ * @param alignment Alignment for the aligned variants (0 otherwise).
+ * @param tag std::nothrow for the nothrow variants (NULL otherwise).
+ * @return The allocated block, or NULL from a nothrow variant.
+ */
+static void *cxx_call_new(int op, size_t size, size_t alignment, const void *tag) {
+    void *fn = cxx_real(op);
+    if (!fn) {
+        safe_log("[new] %s is not defined by any loaded library\n", cxx_operator_names[op]);
+        abort();
+    }
+    if (alignment) {
+        return tag ? ((void *(*)(size_t, size_t, const void *))fn)(size, alignment, tag)
+                   : ((void *(*)(size_t, size_t))fn)(size, alignment);
+    }
+    return tag ? ((void *(*)(size_t, const void *))fn)(size, tag) : ((void *(*)(size_t))fn)(size);
+}
+
+/**
+ * @brief Common body of the operator new interposers.
+ *
+ * The original nothrow variant is called with monitor_busy set, so the
+ * malloc calls it makes are not tracked a second time and the operators
+ * it calls internally (libstdc++ implements nothrow new with the throwing
+ * one) reach the originals. Nothing is unwound through the library while
+ * monitor_busy is set: when the nothrow variant fails, a throwing variant
+ * is called again outside the library to throw std::bad_alloc.
+ *
+ * @param op The interposed operator (CXX_NEW*).
+ * @param size The number of bytes to allocate.
+ * @param alignment Alignment for the aligned variants (0 otherwise).
+ * @param tag std::nothrow for the nothrow variants (NULL otherwise).
+ * @param caller Return address of the new-expression.
+ * @return The allocated block, or NULL from a nothrow variant.
+ */
+static void *cxx_new(int op, size_t size, size_t alignment, const void *tag, void *caller) {
+    static const char nothrow = 0;
+    ensure_init();
+    if (monitor_busy) return cxx_call_new(op, size, alignment, tag);
+    overhead_enter();
+    monitor_busy++;
+    overhead_real_begin();
+    void *ptr = cxx_call_new(tag ? op : op + 2, size, alignment, tag ? tag : &nothrow);
+    overhead_real_end();
+    monitor_busy--;
+    if (ptr) {
+        track_allocation(ptr, size, caller);
+        op_log("[new] size=%zu alignment=%zu | ptr=%p\n", size, alignment, ptr);
+    }
+    overhead_leave(MM_OP_MALLOC);
+    if (!ptr && !tag) return cxx_call_new(op, size, alignment, NULL);
+    return ptr;
+}
+
+/**
+ * @brief Common body of the operator delete interposers.
+ *
+ * The original operator new gets its memory from malloc (or aligned_alloc
+ * for the aligned variants), and every original delete, sized or aligned,
+ * only passes the block to free. A delete is therefore released exactly
+ * like free: through release_block(), with the same membership filter
+ * check, defer mode (MEMORY_MONITOR_DEFER_FREE=1) and double-free
+ * detection.
+ *
+ * The size of a sized delete does not make the lookup cheaper: the
+ * allocation table is keyed by address, so the size can neither locate
+ * the entry nor rule out a probe, and a tracked block is looked up exactly
+ * as for free. The one use of the size is that a block outside the
+ * MEMORY_MONITOR_FILTER_MIN_SIZE..MAX_SIZE range was never tracked, so it
+ * goes straight to real_free without the membership check (its address
+ * left freed_history when the block was allocated, so no double free can
+ * be missed).
+ *
+ * @param ptr The block (may be NULL).
+ * @param size Size of the block for the sized variants (0 otherwise).
+ * @param caller Return address of the delete-expression.
+ */
+static void cxx_delete(void *ptr, size_t size, void *caller) {
+    if (bootstrap_owns(ptr)) return;
+    ensure_init();
+    if (init_resolving) return;
+    if (monitor_busy) {
+        real_free(ptr);
+        return;
+    }
+    overhead_enter();
+    if (size && filters_enabled && (size < filter_min_size || size > filter_max_size) && !guard_owns(ptr)) {
+        call_real_free(ptr);
+    } else {
+        release_block(ptr, caller, "delete");
+    }
+    overhead_leave(MM_OP_FREE);
+}
+
+/** @brief Intercepts operator new(size_t). */
+void *_Znwm(size_t size) {
+    return cxx_new(CXX_NEW, size, 0, NULL, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator new[](size_t). */
+void *_Znam(size_t size) {
+    return cxx_new(CXX_NEW_ARRAY, size, 0, NULL, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator new(size_t, const std::nothrow_t &). */
+void *_ZnwmRKSt9nothrow_t(size_t size, const void *tag) {
+    return cxx_new(CXX_NEW_NOTHROW, size, 0, tag, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator new[](size_t, const std::nothrow_t &). */
+void *_ZnamRKSt9nothrow_t(size_t size, const void *tag) {
+    return cxx_new(CXX_NEW_ARRAY_NOTHROW, size, 0, tag, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator new(size_t, std::align_val_t). */
+void *_ZnwmSt11align_val_t(size_t size, size_t alignment) {
+    return cxx_new(CXX_NEW_ALIGNED, size, alignment, NULL, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator new[](size_t, std::align_val_t). */
+void *_ZnamSt11align_val_t(size_t size, size_t alignment) {
+    return cxx_new(CXX_NEW_ARRAY_ALIGNED, size, alignment, NULL, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator new(size_t, std::align_val_t, const std::nothrow_t &). */
+void *_ZnwmSt11align_val_tRKSt9nothrow_t(size_t size, size_t alignment, const void *tag) {
+    return cxx_new(CXX_NEW_ALIGNED_NOTHROW, size, alignment, tag, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator new[](size_t, std::align_val_t, const std::nothrow_t &). */
+void *_ZnamSt11align_val_tRKSt9nothrow_t(size_t size, size_t alignment, const void *tag) {
+    return cxx_new(CXX_NEW_ARRAY_ALIGNED_NOTHROW, size, alignment, tag, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator delete(void *). */
+void _ZdlPv(void *ptr) {
+    cxx_delete(ptr, 0, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator delete[](void *). */
+void _ZdaPv(void *ptr) {
+    cxx_delete(ptr, 0, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator delete(void *, size_t). */
+void _ZdlPvm(void *ptr, size_t size) {
+    cxx_delete(ptr, size, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator delete[](void *, size_t). */
+void _ZdaPvm(void *ptr, size_t size) {
+    cxx_delete(ptr, size, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator delete(void *, std::align_val_t). */
+void _ZdlPvSt11align_val_t(void *ptr, size_t alignment) {
+    (void)alignment;
+    cxx_delete(ptr, 0, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator delete[](void *, std::align_val_t). */
+void _ZdaPvSt11align_val_t(void *ptr, size_t alignment) {
+    (void)alignment;
+    cxx_delete(ptr, 0, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator delete(void *, size_t, std::align_val_t). */
+void _ZdlPvmSt11align_val_t(void *ptr, size_t size, size_t alignment) {
+    (void)alignment;
+    cxx_delete(ptr, size, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator delete[](void *, size_t, std::align_val_t). */
+void _ZdaPvmSt11align_val_t(void *ptr, size_t size, size_t alignment) {
+    (void)alignment;
+    cxx_delete(ptr, size, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator delete(void *, const std::nothrow_t &). */
+void _ZdlPvRKSt9nothrow_t(void *ptr, const void *tag) {
+    (void)tag;
+    cxx_delete(ptr, 0, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator delete[](void *, const std::nothrow_t &). */
+void _ZdaPvRKSt9nothrow_t(void *ptr, const void *tag) {
+    (void)tag;
+    cxx_delete(ptr, 0, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator delete(void *, std::align_val_t, const std::nothrow_t &). */
+void _ZdlPvSt11align_val_tRKSt9nothrow_t(void *ptr, size_t alignment, const void *tag) {
+    (void)alignment;
+    (void)tag;
+    cxx_delete(ptr, 0, __builtin_return_address(0));
+}
+
+/** @brief Intercepts operator delete[](void *, std::align_val_t, const std::nothrow_t &). */
+void _ZdaPvSt11align_val_tRKSt9nothrow_t(void *ptr, size_t alignment, const void *tag) {
+    (void)alignment;
+    (void)tag;
+    cxx_delete(ptr, 0, __builtin_return_address(0));
 }
\ No newline at end of file
@@ -0,0 +1,91 @@
+/**
+ * @file memory_monitor_ring.h
+ * @brief On-disk layout of the snapshot ring file written by memory_monitor.
+ *
+ * The ring file is a fixed-size file mapped with MAP_SHARED by the library.
+ * It starts with an MMRingHeader followed by @c capacity MMRingRecord slots.
+ * Because the pages belong to the page cache, the records written so far
+ * remain readable after the monitored process is killed (e.g. by the OOM killer).
+ */
+
+#ifndef MEMORY_MONITOR_RING_H
+#define MEMORY_MONITOR_RING_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/**
+ * @brief Magic value stored at the beginning of every ring file ("MMRING01").
+ */
+#define MM_RING_MAGIC 0x31304752494e4d4dULL
+
+/**
+ * @brief Version of the ring file layout.
+ */
+#define MM_RING_VERSION 2
+
+/**
+ * @brief Number of buckets in the live block size histogram.
+ *
+ * Bucket 0 counts blocks of up to 16 bytes, bucket i counts blocks in
+ * (2^(i+3), 2^(i+4)] bytes and the last bucket counts everything larger.
+ */
+#define MM_HIST_BUCKETS 16
+
+/**
+ * @brief Operation types whose monitoring overhead is measured.
+ */
+enum { MM_OP_MALLOC, MM_OP_CALLOC, MM_OP_REALLOC, MM_OP_FREE, MM_OP_MMAP, MM_OP_MUNMAP, MM_OVERHEAD_OPS };
+
+/**
+ * @brief Names of the measured operation types, indexed by MM_OP_*.
+ */
+#define MM_OVERHEAD_OP_NAMES { "malloc", "calloc", "realloc", "free", "mmap", "munmap" }
+
+/**
+ * @brief Units of the overhead counters in MMRingRecord.
+ */
+enum { MM_OVERHEAD_OFF, MM_OVERHEAD_CYCLES, MM_OVERHEAD_NS };
+
+/**
+ * @struct MMRingHeader
+ * @brief Header placed at offset 0 of the ring file.
+ */
+typedef struct MMRingHeader {
+    uint64_t magic;             /**< Always MM_RING_MAGIC. */
+    uint32_t version;           /**< Always MM_RING_VERSION. */
+    uint32_t record_size;       /**< sizeof(MMRingRecord) of the writer. */
+    uint64_t capacity;          /**< Number of record slots following the header. */
+    uint64_t interval_ms;       /**< Snapshot cadence in milliseconds. */
+    int64_t pid;                /**< Process ID of the writer. */
+    _Atomic uint64_t head;      /**< Number of records written so far. */
+    uint32_t overhead_unit;     /**< MM_OVERHEAD_OFF, MM_OVERHEAD_CYCLES or MM_OVERHEAD_NS. */
+    uint32_t reserved32;        /**< Padding. */
+    uint64_t reserved;          /**< Padding up to 64 bytes. */
+} MMRingHeader;
+
+/**
+ * @struct MMRingRecord
+ * @brief A single fixed-size snapshot of the memory state.
+ *
+ * The writer stores an odd @c seq before filling the record and
+ * 2 * (index + 1) afterwards, so a reader can skip slots torn by a crash.
+ */
+typedef struct MMRingRecord {
+    _Atomic uint64_t seq;                   /**< Sequence word (odd while being written). */
+    uint64_t timestamp_ns;                  /**< CLOCK_REALTIME timestamp in nanoseconds. */
+    uint64_t malloc_bytes;                  /**< Live bytes allocated by malloc/calloc/realloc. */
+    uint64_t mmap_bytes;                    /**< Live bytes mapped by mmap. */
+    uint64_t peak_bytes;                    /**< Highest malloc + mmap total seen so far. */
+    uint64_t malloc_calls;                  /**< Number of successful tracked allocations. */
+    uint64_t free_calls;                    /**< Number of tracked deallocations. */
+    uint64_t mmap_calls;                    /**< Number of successful mmap calls. */
+    uint64_t munmap_calls;                  /**< Number of successful munmap calls. */
+    uint64_t live_blocks;                   /**< Number of live malloc blocks. */
+    uint64_t histogram[MM_HIST_BUCKETS];    /**< Live malloc blocks per size bucket. */
+    uint64_t overhead_calls[MM_OVERHEAD_OPS];   /**< Measured calls per operation type. */
+    uint64_t overhead_self[MM_OVERHEAD_OPS];    /**< Cost spent in the library per operation type (see overhead_unit). */
+    uint64_t overhead_real[MM_OVERHEAD_OPS];    /**< Cost spent in the real functions per operation type. */
+} MMRingRecord;
+
+#endif /* MEMORY_MONITOR_RING_H */
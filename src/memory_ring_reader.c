@@ -0,0 +1,148 @@
+/**
+ * @file memory_ring_reader.c
+ * @brief Decodes a snapshot ring file written by memory_monitor and exports it as CSV.
+ *
+ * Usage: memory_ring_reader <ring-file> [minutes]
+ *
+ * The records are printed oldest first, one CSV line per snapshot, which can
+ * be plotted directly (e.g. with gnuplot or a spreadsheet). When @c minutes is
+ * given, only records from the last @c minutes before the newest record are
+ * printed. Slots torn by a crash in the middle of a write, or rewritten
+ * by a live writer while being copied, are skipped.
+ * Overhead columns (calls, library cost and real function cost per
+ * operation type) are zero unless MEMORY_MONITOR_OVERHEAD was set; their
+ * unit is given in the comment line.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "memory_monitor_ring.h"
+
+/**
+ * @brief Copies a record slot and returns its index, or -1 if the slot is empty or torn.
+ *
+ * The sequence word is read before and after the copy. If the writer is
+ * live and rewrites the slot in between, the two reads differ (or the
+ * first one is odd) and the copy is discarded.
+ *
+ * @param slot The record slot in the mapped ring.
+ * @param copy Receives a consistent copy of the record.
+ * @return The zero-based index of the record.
+ */
+static long long record_read(const MMRingRecord *slot, MMRingRecord *copy) {
+    _Atomic uint64_t *seq = &((MMRingRecord *)slot)->seq;
+    uint64_t before = atomic_load_explicit(seq, memory_order_acquire);
+    if (before == 0 || (before & 1)) return -1;
+    memcpy(copy, slot, sizeof(*copy));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(seq, memory_order_relaxed) != before) return -1;
+    return (long long)(before / 2 - 1);
+}
+
+/**
+ * @brief Prints a single record as a CSV line.
+ *
+ * @param record The record to print.
+ */
+static void print_record(const MMRingRecord *record) {
+    printf("%llu.%03llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu",
+           (unsigned long long)(record->timestamp_ns / 1000000000ULL),
+           (unsigned long long)(record->timestamp_ns / 1000000ULL % 1000),
+           (unsigned long long)record->malloc_bytes,
+           (unsigned long long)record->mmap_bytes,
+           (unsigned long long)(record->malloc_bytes + record->mmap_bytes),
+           (unsigned long long)record->peak_bytes,
+           (unsigned long long)record->malloc_calls,
+           (unsigned long long)record->free_calls,
+           (unsigned long long)record->mmap_calls,
+           (unsigned long long)record->munmap_calls,
+           (unsigned long long)record->live_blocks);
+    for (int i = 0; i < MM_HIST_BUCKETS; i++) {
+        printf(",%llu", (unsigned long long)record->histogram[i]);
+    }
+    for (int i = 0; i < MM_OVERHEAD_OPS; i++) {
+        printf(",%llu,%llu,%llu", (unsigned long long)record->overhead_calls[i],
+               (unsigned long long)record->overhead_self[i], (unsigned long long)record->overhead_real[i]);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s <ring-file> [minutes]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    double minutes = argc == 3 ? atof(argv[2]) : 0.0;
+
+    int fd = open(argv[1], O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        return EXIT_FAILURE;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(MMRingHeader)) {
+        fprintf(stderr, "%s: not a ring file\n", argv[1]);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+
+    const MMRingHeader *header = map;
+    if (header->magic != MM_RING_MAGIC || header->version != MM_RING_VERSION ||
+        header->record_size != sizeof(MMRingRecord) ||
+        sizeof(MMRingHeader) + header->capacity * sizeof(MMRingRecord) > (size_t)st.st_size) {
+        fprintf(stderr, "%s: unsupported or corrupted ring file\n", argv[1]);
+        munmap(map, st.st_size);
+        return EXIT_FAILURE;
+    }
+
+    const MMRingRecord *records = (const MMRingRecord *)(header + 1);
+    uint64_t capacity = header->capacity;
+    uint64_t head = atomic_load_explicit(&((MMRingHeader *)header)->head, memory_order_acquire);
+    uint64_t first = head > capacity ? head - capacity : 0;
+
+    uint64_t newest_ns = 0;
+    MMRingRecord record;
+    for (uint64_t i = first; i < head; i++) {
+        if (record_read(&records[i % capacity], &record) == (long long)i && record.timestamp_ns > newest_ns) {
+            newest_ns = record.timestamp_ns;
+        }
+    }
+    uint64_t window_ns = (uint64_t)(minutes * 60.0 * 1e9);
+    uint64_t since_ns = minutes > 0.0 && newest_ns > window_ns ? newest_ns - window_ns : 0;
+
+    static const char *const overhead_units[] = { "off", "cycles", "ns" };
+    static const char *const op_names[] = MM_OVERHEAD_OP_NAMES;
+    printf("# pid=%lld interval_ms=%llu capacity=%llu records_written=%llu overhead_unit=%s\n",
+           (long long)header->pid, (unsigned long long)header->interval_ms,
+           (unsigned long long)capacity, (unsigned long long)head,
+           header->overhead_unit <= MM_OVERHEAD_NS ? overhead_units[header->overhead_unit] : "unknown");
+    printf("time_s,malloc_bytes,mmap_bytes,total_bytes,peak_bytes,malloc_calls,free_calls,mmap_calls,munmap_calls,live_blocks");
+    for (int i = 0; i < MM_HIST_BUCKETS; i++) {
+        printf(",hist_%d", i);
+    }
+    for (int i = 0; i < MM_OVERHEAD_OPS; i++) {
+        printf(",overhead_%s_calls,overhead_%s_self,overhead_%s_real", op_names[i], op_names[i], op_names[i]);
+    }
+    printf("\n");
+
+    for (uint64_t i = first; i < head; i++) {
+        if (record_read(&records[i % capacity], &record) != (long long)i) continue;
+        if (record.timestamp_ns < since_ns) continue;
+        print_record(&record);
+    }
+
+    munmap(map, st.st_size);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+int main() {
+    // Test 1: Aligned allocation functions
+    void *memaligned = NULL;
+    if (posix_memalign(&memaligned, 64, 1000) != 0) {
+        perror("posix_memalign");
+        return 1;
+    }
+    void *blocks[] = { memaligned, aligned_alloc(128, 1024), memalign(256, 1000), valloc(1000), pvalloc(1000) };
+    for (int i = 0; i < 5; i++) {
+        if (!blocks[i]) {
+            perror("aligned allocation");
+            return 1;
+        }
+        memset(blocks[i], 'A', 1000);
+    }
+
+    // Test 2: reallocarray, including an overflowing request
+    volatile size_t huge_count = (size_t)-1 / 2;
+    int *array = reallocarray(NULL, 100, sizeof(int));
+    if (!array) {
+        perror("reallocarray");
+        return 1;
+    }
+    array = reallocarray(array, 1000, sizeof(int));
+    if (!array || reallocarray(array, huge_count, sizeof(int)) != NULL) {
+        fprintf(stderr, "reallocarray failed\n");
+        return 1;
+    }
+
+    // Test 3: Growing a mapping with mremap
+    size_t page = getpagesize();
+    void *mapping = mmap(NULL, 4 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    void *grown = mremap(mapping, 4 * page, 16 * page, MREMAP_MAYMOVE);
+    if (grown == MAP_FAILED) {
+        perror("mremap");
+        return 1;
+    }
+    munmap(grown, 16 * page);
+
+    // Test 4: brk to the current program break
+    if (brk(sbrk(0)) != 0) {
+        perror("brk");
+        return 1;
+    }
+
+    for (int i = 0; i < 5; i++) {
+        free(blocks[i]);
+    }
+    free(array);
+    printf("All aligned allocations completed successfully.\n");
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+// Typ wymagający wyrównanego operatora new
+struct alignas(64) Aligned {
+    char data[200];
+};
+
+// Obiekt globalny alokujący pamięć w konstruktorze (przed main)
+static std::vector<std::string> global_names = { "konstruktor", "globalny", "alokuje pamięć przed main" };
+
+int main() {
+    // Test 1: Scalar and array operators
+    char *scalar = new char;
+    char *vector = new char[3000];
+    memset(vector, 'V', 3000);
+    delete scalar;
+    delete[] vector;
+
+    // Test 2: Aligned operators
+    Aligned *aligned = new Aligned;
+    Aligned *aligned_array = new Aligned[4];
+    if (reinterpret_cast<uintptr_t>(aligned) % 64 || reinterpret_cast<uintptr_t>(aligned_array) % 64) {
+        fprintf(stderr, "aligned operator new returned a misaligned block\n");
+        return 1;
+    }
+    delete aligned;
+    delete[] aligned_array;
+
+    // Test 3: Nothrow and explicitly sized operators
+    int *nothrow = new (std::nothrow) int[50];
+    if (!nothrow) {
+        fprintf(stderr, "nothrow operator new failed\n");
+        return 1;
+    }
+    delete[] nothrow;
+    ::operator delete(::operator new(5000), 5000);
+
+    // Test 4: Failing operator new throws std::bad_alloc
+    volatile size_t huge_size = (size_t)-1 / 4;
+    try {
+        char *huge = new char[huge_size];
+        delete[] huge;
+        fprintf(stderr, "operator new of a huge size succeeded unexpectedly\n");
+        return 1;
+    } catch (const std::bad_alloc &) {
+    }
+
+    // Test 5: Standard containers
+    std::vector<std::string> names(global_names);
+    for (int i = 0; i < 100; i++) {
+        names.push_back(std::string(64, 'x') + std::to_string(i));
+    }
+
+    printf("All C++ allocations completed successfully (%zu names).\n", names.size());
+    return 0;
+}
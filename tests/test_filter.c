@@ -0,0 +1,91 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCKS 64
+#define RACE_ROUNDS 200000
+
+// Alokuje i zwalnia małe (nieśledzone) bloki, które mogą dostać adres zwolniony przez realloc
+static void *untracked_churn(void *arg) {
+    (void)arg;
+    for (int i = 0; i < RACE_ROUNDS; i++) {
+        void *block = malloc(60);
+        free(block);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    char *small[BLOCKS];
+    char *large[BLOCKS / 8];
+
+    // Test 1: Many small blocks (skipped by a minimum size filter)
+    for (int i = 0; i < BLOCKS; i++) {
+        small[i] = malloc(32);
+        if (!small[i]) {
+            perror("malloc");
+            return 1;
+        }
+        memset(small[i], 'S', 32);
+    }
+
+    // Test 2: A few large blocks from another call site
+    for (int i = 0; i < BLOCKS / 8; i++) {
+        large[i] = calloc(1, 8192);
+        if (!large[i]) {
+            perror("calloc");
+            return 1;
+        }
+    }
+
+    // Test 3: An untracked block grown past the size limit
+    char *grown = realloc(small[0], 16384);
+    if (!grown) {
+        perror("realloc");
+        return 1;
+    }
+    small[0] = grown;
+
+    // Test 4: Frees of tracked and untracked blocks (no bad free reports)
+    for (int i = 0; i < BLOCKS; i++) {
+        free(small[i]);
+    }
+    for (int i = 0; i < BLOCKS / 8; i++) {
+        free(large[i]);
+    }
+
+    // Test 5: An address freed by a tracked block and reused by an untracked one
+    char *tracked = malloc(72);
+    free(tracked);
+    char *reused = malloc(60);
+    if (reused != tracked) {
+        printf("The freed address was not reused (%p, %p).\n", (void *)tracked, (void *)reused);
+    }
+    free(reused);
+
+    // Test 6: Double free of a tracked block (reported despite the filters)
+    if (argc > 1 && strcmp(argv[1], "double") == 0) {
+        char *twice = malloc(8192);
+        free(twice);
+        free(twice);
+    }
+
+    // Test 7: Moving reallocs of tracked blocks racing with untracked allocations
+    if (argc > 1 && strcmp(argv[1], "realloc") == 0) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, untracked_churn, NULL) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+        for (int i = 0; i < RACE_ROUNDS; i++) {
+            char *block = malloc(64);
+            char *moved = block ? realloc(block, 32768) : NULL;
+            free(moved ? moved : block);
+        }
+        pthread_join(thread, NULL);
+    }
+
+    printf("All filtered allocations completed successfully.\n");
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Przepełnienie bufora o jeden bajt (wykrywane przez stronę ochronną)
+static int overflow() {
+    char *block = malloc(100);
+    if (!block) {
+        perror("malloc");
+        return 1;
+    }
+    memset(block, 'O', 101);
+    free(block);
+    return 0;
+}
+
+// Zapis do zwolnionego bloku (wykrywany dzięki kwarantannie)
+static int use_after_free() {
+    char *block = malloc(64);
+    if (!block) {
+        perror("malloc");
+        return 1;
+    }
+    free(block);
+    block[0] = 'U';
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "overflow") == 0) return overflow();
+    if (argc > 1 && strcmp(argv[1], "uaf") == 0) return use_after_free();
+
+    // Test 1: Sampled allocations of various sizes stay usable
+    char *blocks[256];
+    for (int i = 0; i < 256; i++) {
+        size_t size = 1 + (size_t)i * 16;
+        blocks[i] = malloc(size);
+        if (!blocks[i]) {
+            perror("malloc");
+            return 1;
+        }
+        memset(blocks[i], 'G', size);
+    }
+    for (int i = 0; i < 256; i++) {
+        free(blocks[i]);
+    }
+
+    // Test 2: calloc returns zeroed memory even when a slot is reused
+    for (int i = 0; i < 256; i++) {
+        unsigned char *zeroed = calloc(32, 4);
+        if (!zeroed) {
+            perror("calloc");
+            return 1;
+        }
+        for (int j = 0; j < 128; j++) {
+            if (zeroed[j] != 0) {
+                fprintf(stderr, "calloc returned dirty memory\n");
+                return 1;
+            }
+        }
+        memset(zeroed, 0xFF, 128);
+        free(zeroed);
+    }
+
+    // Test 3: realloc keeps the contents of a guarded block
+    char *text = malloc(16);
+    if (!text) {
+        perror("malloc");
+        return 1;
+    }
+    strcpy(text, "guarded realloc");
+    char *grown = realloc(text, 8192);
+    if (!grown || strcmp(grown, "guarded realloc") != 0) {
+        fprintf(stderr, "realloc lost the contents of the block\n");
+        return 1;
+    }
+    free(grown);
+
+    // Test 4: malloc_usable_size of guarded blocks, including one of exactly one page
+    size_t sizes[] = { 100, 1000, (size_t)getpagesize() };
+    for (int i = 0; i < 3; i++) {
+        char *block = malloc(sizes[i]);
+        if (!block) {
+            perror("malloc");
+            return 1;
+        }
+        size_t usable = malloc_usable_size(block);
+        if (usable < sizes[i] || usable > sizes[i] + 64) {
+            fprintf(stderr, "malloc_usable_size(%zu-byte block) returned %zu\n", sizes[i], usable);
+            return 1;
+        }
+        memset(block, 'G', usable);
+        free(block);
+    }
+
+    printf("All guarded allocations completed successfully.\n");
+    return 0;
+}
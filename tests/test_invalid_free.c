@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main() {
+    // Test 1: Double free (the monitor reports it and does not pass it to the allocator)
+    char *block = malloc(64);
+    if (!block) {
+        perror("malloc");
+        return 1;
+    }
+    strcpy(block, "Test double free");
+    printf("%s\n", block);
+    free(block);
+    free(block);
+
+    // Test 2: Double free after a realloc moved the block
+    char *moved = malloc(16);
+    if (!moved) {
+        perror("malloc");
+        return 1;
+    }
+    char *grown = realloc(moved, 1024 * 1024);
+    if (!grown) {
+        perror("realloc");
+        free(moved);
+        return 1;
+    }
+    if (grown != moved) {
+        free(moved);
+    }
+    free(grown);
+
+    printf("Invalid frees survived.\n");
+    return 0;
+}
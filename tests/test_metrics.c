@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Pobiera metryki z gniazda biblioteki monitorującej
+static int scrape(const char *path, const char *request, char *buffer, size_t size) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+    if (write(fd, request, strlen(request)) == -1) {
+        perror("write");
+        close(fd);
+        return -1;
+    }
+    size_t total = 0;
+    ssize_t n;
+    while (total + 1 < size && (n = read(fd, buffer + total, size - total - 1)) > 0) {
+        total += n;
+    }
+    buffer[total] = '\0';
+    close(fd);
+    return 0;
+}
+
+int main() {
+    const char *path = getenv("MEMORY_MONITOR_METRICS_SOCKET");
+    if (!path) {
+        fprintf(stderr, "MEMORY_MONITOR_METRICS_SOCKET is not set\n");
+        return 1;
+    }
+    static char response[65536];
+
+    // Test 1: Allocations visible in the metrics
+    char *blocks[8];
+    for (int i = 0; i < 8; i++) {
+        blocks[i] = malloc(4096);
+        if (!blocks[i]) {
+            perror("malloc");
+            return 1;
+        }
+        memset(blocks[i], 'M', 4096);
+    }
+
+    // Test 2: HTTP scrape
+    if (scrape(path, "GET /metrics HTTP/1.0\r\n\r\n", response, sizeof(response)) == -1) return 1;
+    if (strncmp(response, "HTTP/1.0 200 OK", 15) != 0 ||
+        !strstr(response, "memory_monitor_live_bytes{kind=\"malloc\"}") ||
+        !strstr(response, "memory_monitor_site_live_bytes{site=")) {
+        fprintf(stderr, "Unexpected HTTP response:\n%s\n", response);
+        return 1;
+    }
+    printf("%s", response);
+
+    // Test 3: Plain text scrape
+    if (scrape(path, "metrics\n", response, sizeof(response)) == -1) return 1;
+    if (strncmp(response, "# HELP", 6) != 0) {
+        fprintf(stderr, "Unexpected plain response:\n%s\n", response);
+        return 1;
+    }
+
+    // Test 4: Many consecutive scrapes
+    for (int i = 0; i < 100; i++) {
+        if (scrape(path, "metrics\n", response, sizeof(response)) == -1) return 1;
+    }
+
+    // Test 5: Deferred frees are reported as pending, not reconciled by the scrape
+    for (int i = 0; i < 8; i++) {
+        free(blocks[i]);
+    }
+    if (getenv("MEMORY_MONITOR_DEFER_FREE")) {
+        if (scrape(path, "metrics\n", response, sizeof(response)) == -1) return 1;
+        if (!strstr(response, "memory_monitor_pending_frees 8\n")) {
+            fprintf(stderr, "Deferred frees were not reported as pending:\n%s\n", response);
+            return 1;
+        }
+    }
+    printf("All metrics scrapes completed successfully.\n");
+    return 0;
+}
@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define BLOCK_SIZE (8 * 1024 * 1024)
+
+int main() {
+    // Test 1: Large malloc block, fully touched
+    char *block = malloc(BLOCK_SIZE);
+    if (!block) {
+        perror("malloc");
+        return 1;
+    }
+    memset(block, 'N', BLOCK_SIZE);
+
+    // Test 2: Anonymous mapping with only half of the pages touched
+    char *region = mmap(NULL, BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        perror("mmap");
+        free(block);
+        return 1;
+    }
+    memset(region, 'M', BLOCK_SIZE / 2);
+
+    // Test 3: Partially unmapped mapping stays sampled
+    char *trimmed = mmap(NULL, BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (trimmed == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    memset(trimmed, 'T', BLOCK_SIZE);
+    munmap(trimmed + BLOCK_SIZE / 2, BLOCK_SIZE / 2);
+
+    // Czas na kilka cykli próbkowania w tle
+    usleep(200 * 1000);
+
+    printf("All NUMA placement allocations completed successfully.\n");
+    return 0;
+}
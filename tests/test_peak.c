@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define BLOCKS 30
+#define FREED 8
+
+int main() {
+    char *blocks[BLOCKS];
+    char *huge[2];
+
+    // Test 1: Growing set of blocks (the peak is reached with all of them live)
+    for (int i = 0; i < BLOCKS; i++) {
+        blocks[i] = malloc((size_t)(i + 1) * 1000);
+        if (!blocks[i]) {
+            perror("malloc");
+            return 1;
+        }
+        memset(blocks[i], 'P', (size_t)(i + 1) * 1000);
+    }
+
+    // Test 2: Freeing the largest blocks and exceeding the previous peak with two new ones
+    for (int i = BLOCKS - FREED; i < BLOCKS; i++) {
+        free(blocks[i]);
+    }
+    for (int i = 0; i < 2; i++) {
+        huge[i] = malloc(150000);
+        if (!huge[i]) {
+            perror("malloc");
+            return 1;
+        }
+        memset(huge[i], 'H', 150000);
+    }
+
+    // Test 3: Mapping on top of the blocks
+    size_t length = 64 * 4096;
+    char *mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    memset(mapping, 'M', length);
+    munmap(mapping, length);
+
+    // Test 4: Freeing everything and allocating small blocks below the peak
+    for (int i = 0; i < BLOCKS - FREED; i++) {
+        free(blocks[i]);
+    }
+    free(huge[0]);
+    free(huge[1]);
+    for (int i = 0; i < BLOCKS; i++) {
+        blocks[i] = malloc(16);
+        if (!blocks[i]) {
+            perror("malloc");
+            return 1;
+        }
+    }
+    for (int i = 0; i < BLOCKS; i++) {
+        free(blocks[i]);
+    }
+
+    printf("All peak allocations completed successfully.\n");
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Powiększanie bufora małymi krokami (wzorzec, który monitor powinien wykryć)
+static char *grow_in_small_steps(size_t steps) {
+    char *buffer = NULL;
+    size_t size = 0;
+    for (size_t i = 0; i < steps; i++) {
+        size += 64;
+        char *grown = realloc(buffer, size);
+        if (!grown) {
+            perror("realloc");
+            free(buffer);
+            return NULL;
+        }
+        buffer = grown;
+        memset(buffer + size - 64, 'S', 64);
+    }
+    return buffer;
+}
+
+// Powiększanie bufora przez podwajanie rozmiaru
+static char *grow_by_doubling(size_t final_size) {
+    size_t size = 64;
+    char *buffer = malloc(size);
+    if (!buffer) {
+        perror("malloc");
+        return NULL;
+    }
+    while (size < final_size) {
+        char *grown = realloc(buffer, size * 2);
+        if (!grown) {
+            perror("realloc");
+            free(buffer);
+            return NULL;
+        }
+        buffer = grown;
+        memset(buffer + size, 'D', size);
+        size *= 2;
+    }
+    return buffer;
+}
+
+int main() {
+    // Test 1: Many small growths of one buffer
+    char *small_steps = grow_in_small_steps(512);
+    if (!small_steps) return 1;
+
+    // Test 2: Geometric growth to the same size
+    char *doubled = grow_by_doubling(512 * 64);
+    if (!doubled) {
+        free(small_steps);
+        return 1;
+    }
+
+    // Test 3: Shrinking realloc
+    char *shrunk = realloc(doubled, 128);
+    if (!shrunk) {
+        perror("realloc");
+        free(small_steps);
+        free(doubled);
+        return 1;
+    }
+
+    // Test 4: Failing realloc leaves the block untouched
+    char *failed = realloc(small_steps, (size_t)-1 / 2);
+    if (failed) {
+        fprintf(stderr, "realloc of a huge size succeeded unexpectedly\n");
+        free(failed);
+        free(shrunk);
+        return 1;
+    }
+
+    free(small_steps);
+    free(shrunk);
+    printf("All realloc growth patterns completed successfully.\n");
+    return 0;
+}
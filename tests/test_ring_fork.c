@@ -0,0 +1,76 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "../src/memory_monitor_ring.h"
+
+// Alokuje i zwalnia pamięć, aby wątek pierścienia miał co zapisywać
+static void churn(int rounds) {
+    for (int i = 0; i < rounds; i++) {
+        void *block = malloc(1024 + i % 4096);
+        if (block) memset(block, 'R', 1024);
+        free(block);
+    }
+}
+
+int main() {
+    const char *path = getenv("MEMORY_MONITOR_RING");
+    if (!path) {
+        fprintf(stderr, "MEMORY_MONITOR_RING is not set\n");
+        return 1;
+    }
+
+    // Proces potomny bez exec dziedziczy mapowanie pierścienia, ale nie wątek
+    for (int i = 0; i < 3; i++) {
+        churn(1000);
+        pid_t child = fork();
+        if (child == 0) {
+            churn(1000);
+            exit(0);
+        }
+        if (child > 0) waitpid(child, NULL, 0);
+    }
+
+    // Proces potomny z exec dziedziczy LD_PRELOAD i MEMORY_MONITOR_RING
+    for (int i = 0; i < 3; i++) {
+        churn(1000);
+        if (system("sleep 0.05") != 0) {
+            fprintf(stderr, "system() failed\n");
+        }
+    }
+    churn(1000);
+
+    // Ścieżka z %p oznacza osobny pierścień dla każdego procesu
+    if (strstr(path, "%p")) {
+        printf("ring: per-process path, pid=%d\n", (int)getpid());
+        return 0;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        return 1;
+    }
+    MMRingHeader *header = mmap(NULL, sizeof(MMRingHeader), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    int ok = header->magic == MM_RING_MAGIC && header->pid == getpid() && header->capacity > 0 &&
+             atomic_load(&header->head) > 0;
+    printf("ring: pid=%lld (self %d) capacity=%llu head=%llu\n", (long long)header->pid, (int)getpid(),
+           (unsigned long long)header->capacity, (unsigned long long)atomic_load(&header->head));
+    munmap(header, sizeof(MMRingHeader));
+    if (!ok) {
+        fprintf(stderr, "ring was taken over by a child process\n");
+        return 1;
+    }
+    return 0;
+}
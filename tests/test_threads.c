@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define THREADS 4
+#define ITERATIONS 1000
+#define QUEUE_SIZE 64
+#define CHURN_THREADS 100
+
+// Kolejka bloków przekazywanych z wątku producenta do wątku konsumenta
+static void *queue[QUEUE_SIZE];
+static int queue_head = 0;
+static int queue_tail = 0;
+static int producer_done = 0;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+
+// Wątek alokujący i zwalniający własne bloki
+static void *local_worker(void *arg) {
+    size_t base = (size_t)arg;
+    for (int i = 0; i < ITERATIONS; i++) {
+        char *block = malloc(base + i % 128);
+        if (!block) {
+            perror("malloc");
+            return (void *)1;
+        }
+        memset(block, 'T', base + i % 128);
+        free(block);
+    }
+    return NULL;
+}
+
+// Producent: alokuje bloki zwalniane przez konsumenta
+static void *producer(void *arg) {
+    (void)arg;
+    for (int i = 0; i < ITERATIONS; i++) {
+        char *block = malloc(256);
+        if (!block) {
+            perror("malloc");
+            break;
+        }
+        memset(block, 'P', 256);
+        pthread_mutex_lock(&queue_lock);
+        while ((queue_tail + 1) % QUEUE_SIZE == queue_head) {
+            pthread_cond_wait(&queue_cond, &queue_lock);
+        }
+        queue[queue_tail] = block;
+        queue_tail = (queue_tail + 1) % QUEUE_SIZE;
+        pthread_cond_broadcast(&queue_cond);
+        pthread_mutex_unlock(&queue_lock);
+    }
+    pthread_mutex_lock(&queue_lock);
+    producer_done = 1;
+    pthread_cond_broadcast(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+    return NULL;
+}
+
+// Konsument: zwalnia bloki zaalokowane przez producenta
+static void *consumer(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&queue_lock);
+        while (queue_head == queue_tail && !producer_done) {
+            pthread_cond_wait(&queue_cond, &queue_lock);
+        }
+        if (queue_head == queue_tail && producer_done) {
+            pthread_mutex_unlock(&queue_lock);
+            break;
+        }
+        void *block = queue[queue_head];
+        queue_head = (queue_head + 1) % QUEUE_SIZE;
+        pthread_cond_broadcast(&queue_cond);
+        pthread_mutex_unlock(&queue_lock);
+        free(block);
+    }
+    return NULL;
+}
+
+int main() {
+    pthread_t workers[THREADS];
+    pthread_t producer_thread, consumer_thread;
+
+    // Test 1: Threads allocating and freeing their own blocks
+    for (int i = 0; i < THREADS; i++) {
+        if (pthread_create(&workers[i], NULL, local_worker, (void *)(size_t)(16 * (i + 1))) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+    for (int i = 0; i < THREADS; i++) {
+        void *ret;
+        pthread_join(workers[i], &ret);
+        if (ret) return 1;
+    }
+
+    // Test 2: More short-lived threads than thread slots; the slots of exited threads are reused
+    for (int i = 0; i < CHURN_THREADS; i++) {
+        void *ret;
+        if (pthread_create(&workers[0], NULL, local_worker, (void *)(size_t)32) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+        pthread_join(workers[0], &ret);
+        if (ret) return 1;
+    }
+
+    // Test 3: Producer/consumer cross-thread frees
+    if (pthread_create(&producer_thread, NULL, producer, NULL) != 0 ||
+        pthread_create(&consumer_thread, NULL, consumer, NULL) != 0) {
+        perror("pthread_create");
+        return 1;
+    }
+    pthread_join(producer_thread, NULL);
+    pthread_join(consumer_thread, NULL);
+
+    printf("All threaded allocations completed successfully.\n");
+    return 0;
+}